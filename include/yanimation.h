@@ -0,0 +1,66 @@
+#ifndef YANIMATION_H
+#define YANIMATION_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <stdint.h>
+
+enum class led_effect {
+    fade,      // Blend from color to color2 over period_ms
+    chase,     // A dot of color (with a short tail) moving over a background of color2
+    rainbow,   // A rainbow spread over the LEDs, rotating once every period_ms
+    breathe,   // color smoothly fading in and out once every period_ms
+    keyframes, // Each LED blends between the keyframes that apply to it
+};
+
+struct led_keyframe {
+    uint32_t time_ms; // Time from the start of the animation, in increasing order
+    uint16_t led;     // LED this keyframe applies to (1 to num_leds), or 0 for every LED
+    CRGB color;
+};
+
+struct led_animation {
+    led_effect effect;
+
+    // Range of LEDs to animate, from 1 to num_leds (inclusive)
+    uint16_t first_led;
+    uint16_t last_led;
+
+    CRGB color;
+    CRGB color2;
+
+    // Length of one cycle of the effect. Not used for keyframes, where the cycle length is
+    // the time of the last keyframe.
+    uint32_t period_ms;
+
+    // Repeat the effect, or stop after one cycle. A fade that repeats goes back and forth.
+    bool loop;
+
+    // Keyframe list for led_effect::keyframes. The list must stay valid while the
+    // animation is running.
+    const led_keyframe *keyframes;
+    uint8_t num_keyframes;
+};
+
+namespace YAnimation {
+
+// Called after each frame is rendered into the LED buffer, to send it to the LEDs
+typedef void (*commit_function)(void *arg);
+
+static constexpr int max_animations = 8;
+
+// Frames are drawn into leds with leds_mutex held, so they don't mix with other writes
+void setup(CRGB *leds, int num_leds, SemaphoreHandle_t leds_mutex, commit_function commit,
+           void *arg);
+
+// Returns a handle for stop() and is_running(), or -1. Each handle names one animation,
+// so it does nothing once that animation is over, even if its slot has been reused.
+int start(const led_animation &animation);
+void stop(int handle);
+void stop_all();
+bool is_running(int handle);
+void set_frame_rate(uint8_t frames_per_second);
+
+}; // namespace YAnimation
+
+#endif /* YANIMATION_H */
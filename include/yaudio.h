@@ -5,21 +5,67 @@
 #include <stdint.h>
 #include <string>
 
+// Trade-off between how quickly sound starts and how much CPU time audio takes. Lower
+// latency uses smaller, fewer I2S DMA buffers that must be refilled more often, and runs
+// the audio task one priority above the task plan's (see ytasks.h) so it refills them in
+// time. Relaxed latency runs it one priority below the plan's.
+enum class audio_latency {
+    low,     // 4 buffers of 128 bytes (about 6 ms at 44.1 kHz mono), priority raised
+    normal,  // 6 buffers of 512 bytes (about 35 ms), planned priority
+    relaxed, // 8 buffers of 1024 bytes (about 93 ms), fewest wake ups, priority lowered
+};
+
+// Processing applied to everything read from the microphone
+struct mic_settings {
+    // Cutoff of the high-pass filter that takes out rumble and handling noise, in Hz, or
+    // 0 for none. The microphone's DC offset is always removed.
+    uint16_t high_pass_hz = 80;
+
+    // Automatic gain control turns loud and quiet sounds up or down to about
+    // agc_target_percent of full scale. The recording volume then limits how far quiet
+    // sounds are turned up.
+    bool agc = true;
+    uint8_t agc_target_percent = 50;
+};
+
+struct audio_latency_stats {
+    // Time from starting notes or a sound file to the first samples being accepted by
+    // the I2S driver, for the most recent start and the worst so far
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t count;
+
+    // Time for the DMA buffers to play out. Samples accepted by the driver are heard
+    // at most this much later.
+    uint32_t dma_queue_us;
+};
+
 namespace YAudio {
 
-bool setup_speaker(int ws_pin, int bck_pin, int data_pin, int i2s_port);
-bool setup_mic(int ws_pin, int data_pin, int i2s_port);
+bool setup_speaker(int ws_pin, int bck_pin, int data_pin, int i2s_port,
+                   audio_latency latency = audio_latency::normal);
+bool setup_mic(int ws_pin, int data_pin, int i2s_port,
+               audio_latency latency = audio_latency::normal,
+               const mic_settings &settings = mic_settings());
+audio_latency_stats get_latency_stats();
 I2SStream &get_speaker_stream();
 I2SStream &get_mic_stream();
+AudioStream &get_processed_mic_stream();
 void set_wave_volume(uint8_t volume);
 bool add_notes(const std::string &new_notes);
 void stop_speaker();
 bool is_playing();
 bool play_sound_file(const std::string &filename);
+bool play_notes_file(const std::string &filename);
+bool play_midi_file(const std::string &filename);
 bool start_recording(const std::string &filename);
 void stop_recording();
 bool is_recording();
 void set_recording_gain(uint8_t new_gain);
+int start_clip_recording(uint32_t max_duration_ms);
+bool play_clip(int clip, bool loop, int semitones);
+uint32_t get_clip_duration_ms(int clip);
+void delete_clip(int clip);
 }; // namespace YAudio
 
 #endif /* YAUDIO_H */
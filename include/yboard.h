@@ -15,9 +15,15 @@
 #include <IRutils.h>
 #include <SD.h>
 #include <SparkFun_LIS2DH12.h>
+#include <atomic>
+#include <driver/spi_master.h>
 #include <stdint.h>
 
+#include "yanimation.h"
 #include "yaudio.h"
+#include "yfiles.h"
+#include "yprofile.h"
+#include "ytasks.h"
 
 struct accelerometer_data {
     float x;
@@ -25,6 +31,107 @@ struct accelerometer_data {
     float z;
 };
 
+// The two I2C buses on the board. The display and accelerometer are on the upper
+// bus, and the GPIO multiplexer (buttons, switches, DIP switches) is on the lower bus.
+enum class i2c_bus { upper = 0, lower = 1 };
+
+struct i2c_bus_stats {
+    uint32_t frequency;    // Current bus clock in Hz
+    uint32_t transactions; // Number of completed bus transactions
+    uint32_t contended;    // Transactions that had to wait for another task
+    uint64_t busy_us;      // Total time the bus has been held, in microseconds
+    uint32_t max_wait_us;  // Longest time a task waited for the bus, in microseconds
+};
+
+// The OLED display. The driver sets the bus clock at the start and end of each transfer,
+// so the board tells it the upper bus's configured clock to use for both.
+class YDisplay : public Adafruit_SSD1306 {
+  public:
+    using Adafruit_SSD1306::Adafruit_SSD1306;
+    void set_bus_clock(uint32_t frequency) { wireClk = restoreClk = frequency; }
+};
+
+// Most raw timings kept with a received IR frame. This is the size of the receiver's
+// capture buffer, so no capture is cut short.
+static constexpr uint16_t ir_frame_max_raw = 256;
+
+struct ir_frame {
+    decode_results results;         // results.rawbuf points at raw
+    uint16_t raw[ir_frame_max_raw]; // Mark and space timings, results.rawlen of them
+    uint32_t timestamp_ms;          // millis() when the frame was decoded
+};
+
+struct knob_event {
+    int32_t delta;             // Change in the knob value
+    int32_t accelerated_delta; // Change in the accelerated knob value
+    int32_t velocity;          // Knob speed in counts per second (negative when turning down)
+    uint32_t timestamp_ms;     // millis() when the change was seen
+};
+
+// Input event sources. These are bit flags, so they can be combined to filter events.
+enum input_source : uint8_t {
+    input_button = 0x01,      // index is the button number, value is 1 (pressed) or 0
+    input_switch = 0x02,      // index is the switch number, value is 1 (on) or 0
+    input_dip_switch = 0x04,  // index is the DIP switch number, value is 1 (on) or 0
+    input_knob = 0x08,        // value is the change in the knob value
+    input_knob_button = 0x10, // value is 1 (pressed) or 0
+    input_ir = 0x20,          // value is the decoded IR code (lower 32 bits)
+    input_all = 0x3F,
+};
+
+struct io_snapshot {
+    uint8_t buttons;      // Bit 0 is button 1, bit 1 is button 2, and so on
+    uint8_t switches;     // Bit 0 is switch 1, bit 1 is switch 2, and so on
+    uint8_t dip_switches; // Bit 0 is DIP switch 1, bit 1 is DIP switch 2, and so on
+    bool knob_button;
+};
+
+struct input_event {
+    input_source source;
+    uint8_t index; // Button, switch or DIP switch number (starting at 1), otherwise 0
+    int32_t value;
+    uint32_t timestamp_ms; // millis() when the input changed
+};
+
+// Called from the IR transmit task once a queued signal has been sent
+typedef void (*ir_send_callback)(bool success, void *arg);
+
+// The stages run by YBoardV4::setup(), used to look up how long each one took
+enum class setup_stage { leds, i2c, io, sd_card, speaker, mic, accelerometer, display, ir, count };
+
+// What woke the board from YBoardV4::sleep()
+enum class wake_source {
+    timer, // The sleep timeout passed
+    io,    // A button, switch, DIP switch or the knob button changed
+    knob,  // The knob was turned
+    ir,    // An IR signal started arriving
+    other,
+};
+
+struct yboard_setup_config {
+    // Run init stages that don't share a bus at the same time. The SD card and the
+    // upper I2C bus devices are probed on their own tasks while the rest of the
+    // board is brought up.
+    bool parallel = true;
+
+    // Skip probing the SD card until it is first used (playing a file or recording)
+    bool lazy_sd_card = false;
+
+    // Skip probing the accelerometer until it is first read
+    bool lazy_accelerometer = false;
+
+    // How quickly sound starts after playback is triggered, against the CPU time spent
+    // keeping the speaker and microphone buffers serviced
+    audio_latency speaker_latency = audio_latency::normal;
+    audio_latency mic_latency = audio_latency::normal;
+
+    // Filtering and automatic gain control applied to the microphone
+    mic_settings mic;
+
+    // Core and priority of each of the library's background tasks
+    task_plan tasks;
+};
+
 class YBoardV4 {
   public:
     YBoardV4();
@@ -32,9 +139,47 @@ class YBoardV4 {
 
     /*
      *  This function initializes the YBoard. This function must be called before using any of the
-     * YBoard features.
+     * YBoard features. The optional config controls whether independent parts of the board
+     * are brought up at the same time, and whether slow devices are only probed on first use.
+     */
+    void setup(const yboard_setup_config &config = yboard_setup_config());
+
+    /*
+     *  This function returns how long a setup stage took, in microseconds. Stages
+     * that have not run (for example, a lazy stage that hasn't been used yet) return 0.
+     */
+    uint32_t get_setup_stage_time(setup_stage stage);
+
+    /*
+     *  This function prints how long each setup stage took to the serial port.
+     */
+    void print_setup_report();
+
+    /*
+     *  This function prints how much heap memory is free to the serial port, along with
+     * the largest block that can be allocated and the least that has been free since
+     * the board started. It is printed at the end of setup(). Apart from opening files
+     * and decoding MP3s, the library doesn't allocate memory after setup, so later
+     * reports mostly show what the program itself is using.
      */
-    void setup();
+    void print_memory_report();
+
+    /*
+     *  This function prints the library's profiling data to the serial port: how long
+     * LED updates, IO reads, accelerometer reads, display updates, SD card opens and
+     * audio copies have taken, and counts of stalled sound file copies and dropped
+     * events. The data can also be read directly using the YProfile functions. Profiling
+     * can be compiled out by building with -DYBOARD_PROFILING=0.
+     */
+    void print_profile_report();
+
+    /*
+     *  This function prints the library's background tasks to the serial port, with
+     * the core and priority each one runs at, its stack size and the least free stack
+     * it has had. If FreeRTOS run time stats are enabled, it also prints the share of
+     * CPU time each task has used since the last report.
+     */
+    void print_task_report();
 
     ////////////////////////////// LEDs ///////////////////////////////////////////
 
@@ -56,6 +201,38 @@ class YBoardV4 {
      */
     void set_led_brightness(uint8_t brightness);
 
+    /*
+     *  This function turns gamma correction of LED colors on or off. With gamma
+     * correction on, color values are mapped onto a perceptual curve so that fades look
+     * smooth and low values aren't too bright, but values below 15 are turned off. It is
+     * off by default, so colors are sent as they are set.
+     */
+    void set_led_gamma_correction(bool enabled);
+
+    /*
+     *  This function sets the white balance of the LEDs. Each color channel is scaled
+     * by its value out of 255 before being sent to the LEDs. The default is 255 for
+     * all three, meaning no adjustment. For example, lowering blue makes white look
+     * warmer.
+     */
+    void set_led_white_balance(uint8_t red, uint8_t green, uint8_t blue);
+
+    /*
+     *  This function sets the most current, in milliamps, that the LEDs may draw.
+     * Each time the LEDs are updated, the current is estimated from their colors and
+     * brightness, and if it would go over the budget, all the LEDs are dimmed equally
+     * to stay within it. This keeps the board from resetting when many LEDs are bright
+     * at once. The default is 800 mA. A budget of 0 turns the limit off. A budget no more
+     * than the LEDs draw when dark (about 1 mA per LED) keeps them all off.
+     */
+    void set_led_power_budget(uint32_t milliamps);
+
+    /*
+     *  This function returns the estimated current, in milliamps, drawn by the LEDs
+     * after the last update (after any dimming to stay within the power budget).
+     */
+    uint32_t get_led_current();
+
     /*
      *  This function sets the color of all the LEDs on the board.
      *  The red, green, and blue values are integers between 0 and 255, representing
@@ -70,6 +247,40 @@ class YBoardV4 {
      */
     void set_status_led_color(uint8_t red, uint8_t green, uint8_t blue);
 
+    /*
+     *  This function starts an LED animation. Animations are drawn and sent to the LEDs
+     * by a background task at a steady frame rate, so the main loop doesn't need to
+     * call delay() between updates. The animation describes the effect (fade, chase,
+     * rainbow, breathe or keyframes), the range of LEDs to animate, the colors and how
+     * long each cycle takes. Up to 8 animations can run at once; where they overlap, the
+     * one started last is drawn on top. The return value is a handle used to stop the
+     * animation, or -1 if the animation could not be started.
+     */
+    int start_led_animation(const led_animation &animation);
+
+    /*
+     *  This function stops an LED animation started with start_led_animation. The LEDs
+     * keep the colors from the last frame that was drawn.
+     */
+    void stop_led_animation(int handle);
+
+    /*
+     *  This function stops all LED animations.
+     */
+    void stop_all_led_animations();
+
+    /*
+     *  This function returns whether an LED animation is still running. Animations
+     * that don't loop stop by themselves after one cycle.
+     */
+    bool is_led_animation_running(int handle);
+
+    /*
+     *  This function sets how many times per second LED animations are drawn. The
+     * default is 50.
+     */
+    void set_led_frame_rate(uint8_t frames_per_second);
+
     ////////////////////////////// Switches/Buttons ///////////////////////////////
     /*
      *  This function returns the state of a switch.
@@ -139,6 +350,38 @@ class YBoardV4 {
      */
     void set_knob(int64_t value);
 
+    /*
+     *  This function returns how fast the knob is turning, in counts per second. The
+     * value is positive when the knob value is going up, negative when it is going
+     * down, and 0 when the knob is still.
+     */
+    int32_t get_knob_velocity();
+
+    /*
+     *  This function returns the accelerated knob value. This works like get_knob(),
+     * except that each step counts for more when the knob is turned quickly. This makes
+     * it possible to move through a large range of values quickly, while still being
+     * able to make fine adjustments by turning slowly. It is reset and set along with
+     * the regular knob value by reset_knob() and set_knob().
+     */
+    int64_t get_knob_accelerated();
+
+    /*
+     *  This function sets how much fast turns are sped up for get_knob_accelerated().
+     * max_multiplier is how many counts each step is worth when the knob is spun
+     * quickly. Slow turns always count 1 per step. The default is 10, and 1 turns
+     * acceleration off.
+     */
+    void set_knob_acceleration(uint8_t max_multiplier);
+
+    /*
+     *  This function removes the next knob change from the queue. Each event holds how
+     * much the knob moved, the accelerated change, the speed and the time it was seen.
+     * timeout_ms is how long to wait if no event is queued (default is 0, meaning don't
+     * wait). The function returns true if an event was received, and false otherwise.
+     */
+    bool get_knob_event(knob_event &event, uint32_t timeout_ms = 0);
+
     /*
      *  This function returns the state of a DIP switch.
      *  The dip_switch_idx is an integer between 1 and 6, representing the number of
@@ -155,6 +398,33 @@ class YBoardV4 {
      */
     uint8_t get_dip_switches();
 
+    /*
+     *  This function returns the state of all buttons, switches, DIP switches and the
+     * knob button at once. The values are always from the same moment, whereas calling
+     * the individual functions one after the other could mix state from before and
+     * after a change.
+     */
+    io_snapshot get_io_snapshot();
+
+    ////////////////////////////// Input Events ///////////////////////////////////
+    /*
+     *  This function removes the next input event from the event queue. Buttons,
+     * switches, DIP switches, the knob, the knob button and the IR receiver all add an
+     * event to this queue whenever they change, so a program can handle every input
+     * in one place instead of checking each one. timeout_ms is how long to wait for an
+     * event if none is queued (default is 0, meaning don't wait). Pass portMAX_DELAY to
+     * sleep until something happens. The function returns true if an event was
+     * received, and false otherwise.
+     */
+    bool get_input_event(input_event &event, uint32_t timeout_ms = 0);
+
+    /*
+     *  This function chooses which sources add events to the input event queue.
+     * sources is a combination of input_source flags, for example
+     * input_button | input_knob. The default is input_all.
+     */
+    void set_input_event_filter(uint8_t sources);
+
     ////////////////////////////// Speaker/Tones //////////////////////////////////
     /*
      *  This function plays a sound on the speaker. The filename is a string
@@ -195,7 +465,13 @@ class YBoardV4 {
      * O followed by a #    Changes the octave. Valid range is 4-7. Default is 5.
      * T followed by a #    Changes the tempo. Valid range is 40-240. Default is 120.
      * V followed by a #    Changes the volume.  Valid range is 1-10. Default is 5.
-     * !                    Resets octave, tempo, and volume to default values.
+     * W followed by        Changes how each note starts and ends (its envelope). The
+     *   a,d,s,r            note rises to full volume over a milliseconds, falls to s percent
+     *                      of full volume over d milliseconds, and is held there until it
+     *                      ends, when it fades out over r milliseconds. Times can be up to
+     *                      10000. Default is W5,0,100,20. For example, W2,300,0,0 sounds
+     *                      plucked and W80,0,100,200 sounds soft.
+     * !                    Resets octave, tempo, volume, and envelope to default values.
      * spaces               Spaces can be placed between notes or commands for readability,
      *                      but not within a note or command (eg: "C4# D4" is valid, "C 4 # D 4" is
      *                      not. "T120 A B C" is valid, "T 120 A B C" is not).
@@ -211,6 +487,38 @@ class YBoardV4 {
      */
     bool play_notes_background(const std::string &new_notes);
 
+    /*
+     *  This function plays notes stored in a text file on the microSD card, written in
+     * the same way as for play_notes. The file is read a little at a time as the notes
+     * play, so it can be as long as needed. The function returns once the notes have
+     * finished playing. It returns false if the file can't be opened.
+     */
+    bool play_notes_file(const std::string &filename);
+
+    /* This is similar to the function above, except that it will start the notes playing
+     * in the background and return immediately. The notes will continue to play in the
+     * background until they are stopped with the stop_audio function, another file or
+     * notes are played, or the notes finish. play_notes_background can't add notes while
+     * a notes file is playing.
+     */
+    bool play_notes_file_background(const std::string &filename);
+
+    /*
+     *  This function plays a MIDI file (.mid) stored on the microSD card, using the same
+     * tones as play_notes. Up to four notes can sound at once, and drums (channel 10) are
+     * left out. MIDI files are much smaller than sound files, and are read a little at a
+     * time as they play. The function returns once the song has finished. It returns
+     * false if the file can't be opened or isn't a MIDI file.
+     */
+    bool play_midi_file(const std::string &filename);
+
+    /* This is similar to the function above, except that it will start the song playing
+     * in the background and return immediately. The song will continue to play in the
+     * background until it is stopped with the stop_audio function, another file or notes
+     * are played, or the song finishes.
+     */
+    bool play_midi_file_background(const std::string &filename);
+
     /*
      * This function stops the audio from playing (either a song or a sequence of notes)
      */
@@ -230,6 +538,15 @@ class YBoardV4 {
      */
     I2SStream &get_speaker_stream();
 
+    /*
+     *  This function returns how long sound has taken to start: the time from calling
+     * one of the play functions to the first samples reaching the speaker's I2S driver,
+     * for the most recent call and the slowest so far. dma_queue_us is how much audio
+     * the driver buffers, which is how much later than that the sound may be heard. The
+     * buffering can be changed with the speaker_latency setup option.
+     */
+    audio_latency_stats get_audio_latency();
+
     ////////////////////////////// Microphone ////////////////////////////////////////
     /*
      *  This function starts recording audio from the microphone. The filename is a
@@ -250,9 +567,49 @@ class YBoardV4 {
      */
     bool is_recording();
 
+    /*
+     *  This function starts recording audio from the microphone into memory instead of
+     * a file, as a clip that can be played back straight away. The recording stops after
+     * max_duration_ms milliseconds, or when stop_recording is called. The function
+     * returns a number identifying the clip, to pass to the other clip functions, or -1
+     * if the recording couldn't be started. Clips use PSRAM if the board has it, at
+     * about 88 KB per second of recording, and stay in memory until deleted. Up to 8
+     * clips can exist at once.
+     */
+    int start_clip_recording(uint32_t max_duration_ms);
+
+    /*
+     *  This function plays a clip recorded with start_clip_recording. semitones shifts
+     * the pitch up or down by that many half steps (up to 24), which also makes the clip
+     * play faster or slower. The function returns once the clip has finished playing.
+     */
+    bool play_clip(int clip, int semitones = 0);
+
+    /* This is similar to the function above, except that it will start the clip playing
+     * in the background and return immediately. If loop is true, the clip plays over and
+     * over until it is stopped with the stop_audio function. Playing a clip while
+     * another is playing starts the new one at once, so clips can be triggered like the
+     * pads of a sampler.
+     */
+    bool play_clip_background(int clip, bool loop = false, int semitones = 0);
+
+    /*
+     *  This function returns how long a clip is in milliseconds, or 0 if there is no
+     * such clip.
+     */
+    uint32_t get_clip_duration(int clip);
+
+    /*
+     *  This function deletes a clip and frees its memory, stopping it first if it is
+     * playing or being recorded.
+     */
+    void delete_clip(int clip);
+
     /*
      *  This function sets the volume of the microphone when recording. The volume is
      * an integer between 0 and 12. A volume of 0 is off, and a volume of 12 is full volume.
+     * With automatic gain control on (the default, see the mic setup option), this is the
+     * most that quiet sounds are turned up; loud sounds are turned down whatever it is.
      */
     void set_recording_volume(uint8_t volume);
 
@@ -265,6 +622,34 @@ class YBoardV4 {
      */
     I2SStream &get_microphone_stream();
 
+    /*
+     *  This function returns a stream of the microphone's audio after it has been
+     * filtered and had its gain set, in the same way as recordings. It reads from the
+     * stream returned by get_microphone_stream(), so only one of the two should be read
+     * from. This is an advanced function.
+     */
+    AudioStream &get_processed_mic_stream();
+
+    ////////////////////////////// microSD Card //////////////////////////////////////
+    /*
+     *  This function returns whether a file exists on the microSD card. The card's
+     * files are indexed when it is set up, so this doesn't need to read the card.
+     */
+    bool file_exists(const std::string &filename);
+
+    /*
+     *  This function returns the size of a file on the microSD card in bytes, or 0 if
+     * the file doesn't exist.
+     */
+    size_t get_file_size(const std::string &filename);
+
+    /*
+     *  This function indexes the files on the microSD card again. The index is kept up
+     * to date when recording, but this must be called after changing files on the card
+     * in other ways (for example, through the SD library) so the changes are seen.
+     */
+    void rebuild_file_index();
+
     ///////////////////////////// Accelerometer ////////////////////////////////////
     /*
      *  This function returns whether accelerometer data is available.
@@ -282,6 +667,48 @@ class YBoardV4 {
      */
     accelerometer_data get_accelerometer();
 
+    ////////////////////////////// I2C Buses //////////////////////////////////////
+    /*
+     *  This function sets the clock frequency of an I2C bus, in Hz. The upper
+     * bus supports up to 400 kHz (limited by the accelerometer), and the lower
+     * bus supports up to 1 MHz. Both buses default to 400 kHz. The return type is a
+     * boolean value (true or false). True corresponds to the frequency being
+     * applied, and false corresponds to the frequency being out of range.
+     */
+    bool set_i2c_frequency(i2c_bus bus, uint32_t frequency);
+
+    /*
+     *  This function gives the calling task exclusive use of an I2C bus. All library
+     * functions that talk to a device take this lock, so it only needs to be called
+     * when talking to a device directly (for example, using the display object).
+     * Waiting tasks are served in priority order, so the library's IO handling
+     * always goes ahead of bulk transfers such as display updates. The lock can be
+     * taken more than once by the same task, and each lock_i2c_bus call must be
+     * matched by a call to unlock_i2c_bus. The return type is a boolean value (true
+     * or false). True corresponds to the bus being locked, and false corresponds to
+     * the timeout expiring first.
+     */
+    bool lock_i2c_bus(i2c_bus bus, uint32_t timeout_ms = portMAX_DELAY);
+
+    /*
+     *  This function releases an I2C bus locked with lock_i2c_bus.
+     */
+    void unlock_i2c_bus(i2c_bus bus);
+
+    /*
+     *  This function returns the utilisation counters for an I2C bus.
+     */
+    i2c_bus_stats get_i2c_stats(i2c_bus bus);
+
+    ///////////////////////////// Display ////////////////////////////////////////
+    /*
+     *  This function sends the display buffer to the display. This is the same as
+     * calling display.display(), but it takes the upper I2C bus lock for the
+     * duration of the transfer so it is safe to call while other tasks use the
+     * accelerometer.
+     */
+    void update_display();
+
     /*
      *  This function fetches the I/O values from the GPIO multiplexer,
      *  and stores them in the cached array.
@@ -289,29 +716,46 @@ class YBoardV4 {
     void recache_all_io_vals();
 
     /*
-     *  This function recaches just a single I/O value from the GPIO multiplexer,
-     *  based on the last interrupt that was triggered.
+     *  This function updates the cached I/O values after an interrupt from the GPIO
+     *  multiplexer. All of the inputs are read in a single transfer, so changes to
+     *  several inputs at once are all picked up.
      */
     void recache_io_val_on_interrupt();
 
     //////////////////////////////////// IR //////////////////////////////////////////
 
     /*
-     *  This function decodes the IR signal received by the IR receiver. It
-     *  returns true if a valid IR signal was received and decoded, and false
-     *  otherwise. If a valid signal was received, the decoded signal can be
+     *  This function checks for a received IR signal. IR signals are decoded in the
+     *  background as they arrive and queued, so none are lost while the main loop is
+     *  busy. This function returns true if a decoded signal was waiting, and false
+     *  otherwise. If a signal was waiting, it is removed from the queue and can be
      *  accessed through the ir_results variable.
      */
     bool recv_ir();
 
     /*
-     *  This function clears the IR receiver's buffer and resets the state of the
-     *  IR receiver. This is necessary to ensure that the IR receiver is ready
-     *  to receive a new signal. Call this function after recv_ir() is
-     *  successful.
+     *  This function used to be required after recv_ir() to get the IR receiver
+     *  ready for the next signal. The receiver now restarts automatically, so this
+     *  function does nothing and is only kept so existing programs still work.
      */
     void clear_ir();
 
+    /*
+     *  This function removes the next received IR frame from the queue. Each frame
+     *  holds the decoded signal and the time it was received. timeout_ms is how long
+     *  to wait for a frame if none is queued (default is 0, meaning don't wait). The
+     *  function returns true if a frame was received, and false otherwise. Each frame
+     *  has its own copy of the raw timings, so results.rawbuf stays valid for as long
+     *  as the frame does.
+     */
+    bool get_ir_frame(ir_frame &frame, uint32_t timeout_ms = 0);
+
+    /*
+     *  This function removes up to max_frames received IR frames from the queue in
+     *  one call and returns how many were copied into frames.
+     */
+    size_t get_ir_frames(ir_frame *frames, size_t max_frames);
+
     /*
      *  This function sends an IR signal using the IR transmitter. The signal is
      *  specified by the results parameter, which should contain a valid IR
@@ -331,8 +775,40 @@ class YBoardV4 {
      */
     bool send_ir(uint64_t data, uint16_t nbits, uint16_t repeat = 0);
 
+    /*
+     *  These functions are similar to the send_ir functions above, except that they
+     *  queue the signal and return immediately. Signals are sent in order by a
+     *  background task, so sending doesn't hold up LED animations, audio control or
+     *  the main loop. If a callback is given, it is called with the result and arg
+     *  once the signal has been sent. Keep the callback short, as it runs on the
+     *  transmit task. The functions return true if the signal was queued, and false
+     *  if the data is invalid or the queue is full.
+     */
+    bool send_ir_background(decode_results &data, uint16_t repeat = 0,
+                            ir_send_callback callback = NULL, void *arg = NULL);
+    bool send_ir_background(uint64_t data, uint16_t nbits, uint16_t repeat = 0,
+                            ir_send_callback callback = NULL, void *arg = NULL);
+
+    /*
+     *  This function returns whether any IR signals are queued or being sent.
+     */
+    bool is_ir_sending();
+
+    ////////////////////////////// Power //////////////////////////////////////////
+
+    /*
+     *  This function puts the board into light sleep to save power. The board wakes when
+     * a button, switch, DIP switch or the knob button changes, the knob is turned, an IR
+     * signal arrives, or timeout_ms passes (default is 0, meaning no timeout). Before
+     * sleeping, sound playback and recording are stopped, queued IR signals are sent, and
+     * the LEDs and display are turned off. They are turned back on when the board wakes,
+     * and any input changes made while asleep are picked up. The IR signal that wakes the
+     * board is usually not decoded. The function returns what woke the board.
+     */
+    wake_source sleep(uint32_t timeout_ms = 0);
+
     // Display
-    Adafruit_SSD1306 display;
+    YDisplay display;
     static constexpr int display_width = 128;
     static constexpr int display_height = 64;
 
@@ -364,34 +840,108 @@ class YBoardV4 {
 
     static constexpr int num_buttons = 5;
     static constexpr int num_switches = 4;
+    static constexpr int num_dip_switches = 6;
 
   private:
     static constexpr int num_leds_with_status_led = num_leds + 1;
     CRGB leds_with_status_led[num_leds_with_status_led];
 
+    // Colors actually sent to the LEDs, after gamma and white balance correction
+    CRGB leds_output[num_leds_with_status_led];
+    bool led_gamma_enabled = false;
+    uint8_t led_white_balance[3] = {255, 255, 255};
+    uint8_t led_correction[3][256];
+    void update_led_correction();
+
+    // LED power budget. The per-channel figures are the current drawn by one channel at
+    // full brightness, taken from FastLED's power model.
+    static constexpr uint32_t led_red_ma = 16;
+    static constexpr uint32_t led_green_ma = 11;
+    static constexpr uint32_t led_blue_ma = 15;
+    static constexpr uint32_t led_idle_ma = 1;
+    uint8_t led_brightness = 255;
+    uint32_t led_power_budget_ma = 800;
+    uint32_t led_current_ma = 0;
+
+    // Serialises LED updates between the main loop and the animation task
+    SemaphoreHandle_t leds_mutex = NULL;
+    StaticSemaphore_t leds_mutex_buffer;
+    static void commit_animation_frame(void *arg);
+
     bool wire_begin = false;
     bool sd_card_present = false;
-
-    // Buttons are stored in a bitmask, with button1 at bit 0, button2 at bit 1, etc.
-    // This is cached from the GPIO multiplexer.
-    uint8_t buttons_cached;
-
-    // Switches, same format as buttons
-    uint8_t sw_cached;
-
-    // Dip switches, same format as buttons
-    uint8_t dsw_cached;
-
-    bool knob_button_cached;
+    bool sd_card_probed = false;
+    bool accelerometer_present = false;
+    bool accelerometer_probed = false;
+    audio_latency speaker_latency = audio_latency::normal;
+    audio_latency mic_latency = audio_latency::normal;
+    mic_settings mic_processing;
+    bool display_present = false;
+
+    // Set while the board is asleep, so LED updates (including animation frames) are
+    // sent as black
+    bool leds_asleep = false;
+
+    // Setup timing, in microseconds, indexed by setup_stage
+    uint32_t setup_stage_us[static_cast<int>(setup_stage::count)] = {};
+    uint32_t setup_total_us = 0;
+
+    // All IO state cached from the GPIO multiplexer, packed into one word so it is
+    // always updated and read as a whole. Each field is a bitmask with button1 (or
+    // switch1, etc.) at the lowest bit of the field.
+    static constexpr int io_buttons_shift = 0;
+    static constexpr int io_switches_shift = 8;
+    static constexpr int io_dip_switches_shift = 16;
+    static constexpr int io_knob_button_shift = 24;
+    std::atomic<uint32_t> io_state;
+    static io_snapshot unpack_io_state(uint32_t state);
+
+    // Input event queue
+    static constexpr int input_queue_length = 32;
+    QueueHandle_t input_queue = NULL;
+    StaticQueue_t input_queue_buffer;
+    uint8_t input_queue_storage[input_queue_length * sizeof(input_event)];
+    uint8_t input_filter = input_all;
+    void publish_input_event(input_source source, uint8_t index, int32_t value);
+    void publish_io_changes(uint32_t old_state, uint32_t new_state);
 
     // I2C buses
     TwoWire upperWire = TwoWire(0);
     TwoWire lowerWire = TwoWire(1);
 
+    // Per-bus lock and utilisation counters, indexed by i2c_bus
+    struct i2c_bus_state {
+        TwoWire *wire;
+        SemaphoreHandle_t mutex;
+        uint8_t lock_depth;
+        uint32_t lock_start_us;
+        i2c_bus_stats stats;
+    };
+    i2c_bus_state i2c_buses[2];
+    StaticSemaphore_t i2c_mutex_buffers[2];
+
     // LEDs
     static constexpr int led_clock_pin = 4;
     static constexpr int led_data_pin = 5;
 
+    // LED SPI output. The SD card uses SPI2 (the Arduino SPI object), so the LEDs get SPI3.
+    // A frame is a 4-byte start frame, 4 bytes per LED, and an end frame of at least one
+    // clock edge per two LEDs.
+    static constexpr spi_host_device_t led_spi_host = SPI3_HOST;
+    static constexpr int led_spi_clock_hz = 10000000;
+    static constexpr int led_spi_end_frame_size = (num_leds_with_status_led + 15) / 16 + 1;
+    static constexpr int led_spi_frame_size =
+        4 + num_leds_with_status_led * 4 + led_spi_end_frame_size;
+    spi_device_handle_t led_spi = NULL;
+    spi_transaction_t led_spi_transaction;
+    alignas(4) uint8_t led_spi_buffers[2][(led_spi_frame_size + 3) & ~3];
+    int led_spi_next = 0;
+    bool led_spi_in_flight = false;
+    bool leds_setup = false;
+    bool setup_led_spi();
+    void send_led_spi_frame(uint8_t brightness);
+    void wait_led_spi_frame();
+
     // GPIO Multiplexer
     static constexpr int gpio_dsw1 = 0;
     static constexpr int gpio_dsw2 = 1;
@@ -415,13 +965,33 @@ class YBoardV4 {
     static constexpr int rot_enc_a = 37;
     static constexpr int rot_enc_b = 38;
 
+    // Knob service. The encoder is sampled every knob_poll_ms, and the velocity is a
+    // moving average over roughly the last knob_velocity_smoothing samples. Acceleration
+    // ramps the step multiplier from 1 at knob_slow_cps up to the maximum at knob_fast_cps.
+    static constexpr int knob_poll_ms = 5;
+    static constexpr int knob_velocity_smoothing = 4;
+    static constexpr int knob_slow_cps = 20;
+    static constexpr int knob_fast_cps = 200;
+    static constexpr int knob_queue_length = 16;
+    portMUX_TYPE knob_lock = portMUX_INITIALIZER_UNLOCKED;
+    QueueHandle_t knob_queue = NULL;
+    StaticQueue_t knob_queue_buffer;
+    uint8_t knob_queue_storage[knob_queue_length * sizeof(knob_event)];
+    int64_t knob_last_count = 0;
+    int64_t knob_accelerated = 0;
+    int32_t knob_velocity = 0;
+    uint8_t knob_max_multiplier = 10;
+    static void knob_task(void *params);
+
     // I2C Connections
     static constexpr int sda_pin = 2;
     static constexpr int scl_pin = 1;
-    static constexpr int upper_i2c_freq = 100000;
+    static constexpr int upper_i2c_freq = 400000;
+    static constexpr int upper_i2c_max_freq = 400000;
     static constexpr int upper_i2c_data = 2;
     static constexpr int upper_i2c_clk = 1;
-    static constexpr int lower_i2c_freq = 100000;
+    static constexpr int lower_i2c_freq = 400000;
+    static constexpr int lower_i2c_max_freq = 1000000;
     static constexpr int lower_i2c_data = 18;
     static constexpr int lower_i2c_clk = 17;
 
@@ -436,6 +1006,10 @@ class YBoardV4 {
     static constexpr int spi_miso_pin = 13;
     static constexpr int spi_sck_pin = 12;
 
+    // Open files allowed on the card. The file cache keeps a few handles open, so this is
+    // raised from the SD library's default of 5.
+    static constexpr int sd_max_open_files = 8;
+
     // I2S Speaker Connections
     static constexpr int speaker_i2s_data_pin = 14;
     static constexpr int speaker_i2s_bclk_pin = 21;
@@ -451,6 +1025,35 @@ class YBoardV4 {
     static constexpr int ir_tx_pin = 7;
     static constexpr int ir_rx_pin = 36;
 
+    // IR receive queue
+    static constexpr int ir_rx_buffer_size = ir_frame_max_raw;
+    static constexpr int ir_rx_timeout_ms = 15;
+    static constexpr int ir_rx_queue_length = 16;
+    static constexpr int ir_rx_poll_ms = 5;
+    QueueHandle_t ir_rx_queue = NULL;
+    StaticQueue_t ir_rx_queue_buffer;
+    uint8_t ir_rx_queue_storage[ir_rx_queue_length * sizeof(ir_frame)];
+    uint16_t ir_results_raw[ir_frame_max_raw]; // Timings for ir_results.rawbuf
+    static void ir_rx_task(void *params);
+
+    // IR transmit queue
+    struct ir_send_request {
+        decode_type_t type;
+        uint64_t value;
+        uint16_t nbits;
+        uint16_t repeat;
+        ir_send_callback callback;
+        void *arg;
+    };
+    static constexpr int ir_tx_queue_length = 8;
+    QueueHandle_t ir_tx_queue = NULL;
+    StaticQueue_t ir_tx_queue_buffer;
+    uint8_t ir_tx_queue_storage[ir_tx_queue_length * sizeof(ir_send_request)];
+    std::atomic<int> ir_tx_pending;
+    static void ir_tx_task(void *params);
+    bool queue_ir_send(const ir_send_request &request);
+    bool check_ir_data(const decode_results &data);
+
     void setup_i2c();
     void setup_leds();
     void setup_io();
@@ -460,6 +1063,15 @@ class YBoardV4 {
     bool setup_sd_card();
     bool setup_display();
     bool setup_ir();
+
+    void show_leds();
+    void lock_leds();
+    void unlock_leds();
+    bool run_setup_stage(setup_stage stage);
+    static void setup_stage_task(void *params);
+    bool ensure_sd_card();
+    bool ensure_accelerometer();
+    void set_display_power(bool on);
 };
 
 extern YBoardV4 Yboard;
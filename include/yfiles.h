@@ -0,0 +1,41 @@
+#ifndef YFILES_H
+#define YFILES_H
+
+#include <FS.h>
+#include <stddef.h>
+
+// An index of the files on the SD card, kept in RAM so lookups don't have to walk the FAT
+// directory over SPI, and a small cache of open file handles for files that are played
+// repeatedly. Paths start with / and are matched without regard to case, like the card
+// itself. Looking up a file, or reopening one that is cached, doesn't allocate memory.
+
+namespace YFiles {
+
+// Walks the card and builds the index. Called once the card has been mounted.
+bool setup(fs::FS &fs);
+
+// Throws away the index and cached handles and walks the card again. Use this after
+// files have been changed other than through this module.
+bool rebuild_index();
+
+bool exists(const char *path);
+bool get_size(const char *path, size_t &size);
+size_t get_num_files();
+
+// Opens a file for reading. The handle belongs to the caller alone. If the file was
+// released recently, its cached handle is taken out of the cache and rewound to the start
+// instead of opening the file again.
+File open_read(const char *path);
+
+// Hands a handle from open_read() back to the cache, so the next open_read() of the file
+// can reuse it, and empties file. The handle must not be used again.
+void release(File &file);
+
+// Opens a file for writing, replacing any existing file. Call update_size() once the
+// file has been written and closed.
+File open_write(const char *path);
+void update_size(const char *path, size_t size);
+
+}; // namespace YFiles
+
+#endif /* YFILES_H */
@@ -0,0 +1,78 @@
+#ifndef YPROFILE_H
+#define YPROFILE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Set YBOARD_PROFILING to 0 (for example, with build_flags = -DYBOARD_PROFILING=0) to
+// compile all of the instrumentation out of the library.
+#ifndef YBOARD_PROFILING
+#define YBOARD_PROFILING 1
+#endif
+
+namespace YProfile {
+
+// Instrumented call sites
+enum site {
+    led_show,
+    mcp_read,
+    accel_read,
+    display_flush,
+    sd_open,
+    audio_copy,
+    mic_process,
+    num_sites,
+};
+
+// Event counters
+enum counter {
+    audio_stalls,    // Sound file copies that moved nothing although the file had data left
+    audio_underruns, // Times the speaker ran out of audio in the middle of a sound
+    dropped_events,  // Input events and interrupts lost because they came too quickly
+    num_counters,
+};
+
+// Bucket i of the histogram counts calls that took less than 2^i microseconds (and at
+// least 2^(i-1)). The last bucket also counts everything longer.
+static constexpr int num_buckets = 20;
+
+struct site_stats {
+    uint32_t calls;
+    uint64_t total_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t histogram[num_buckets];
+};
+
+void record(site s, uint32_t cycles);
+void count(counter c, uint32_t amount);
+site_stats get_site_stats(site s);
+uint32_t get_counter(counter c);
+void reset();
+void print_report(Print &out = Serial);
+
+// Times the enclosing scope and records it against a call site
+class ScopedTimer {
+  public:
+    explicit ScopedTimer(site s) : s(s), start(ESP.getCycleCount()) {}
+    ~ScopedTimer() { record(s, ESP.getCycleCount() - start); }
+
+  private:
+    site s;
+    uint32_t start;
+};
+
+}; // namespace YProfile
+
+#if YBOARD_PROFILING
+#define YPROFILE_CONCAT_INNER(a, b) a##b
+#define YPROFILE_CONCAT(a, b) YPROFILE_CONCAT_INNER(a, b)
+#define YPROFILE_SCOPE(s)                                                                          \
+    YProfile::ScopedTimer YPROFILE_CONCAT(yprofile_timer_, __LINE__)(YProfile::s)
+#define YPROFILE_COUNT(c, amount) YProfile::count(YProfile::c, amount)
+#else
+#define YPROFILE_SCOPE(s) (void)0
+#define YPROFILE_COUNT(c, amount) (void)0
+#endif
+
+#endif /* YPROFILE_H */
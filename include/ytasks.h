@@ -0,0 +1,66 @@
+#ifndef YTASKS_H
+#define YTASKS_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// Where and at what priority a library task runs. core is 0, 1, or tskNO_AFFINITY to let
+// the scheduler pick.
+struct task_settings {
+    BaseType_t core;
+    UBaseType_t priority;
+};
+
+// Scheduling plan for the library's background tasks. The Arduino loop runs on core 1 at
+// priority 1, and WiFi and Bluetooth run on core 0. Audio gets core 0 to itself (apart
+// from the radio) at a high priority so playback and recording don't stutter when the
+// loop is busy. IO handling runs on core 1 above the loop, so inputs are served promptly
+// without competing with audio. The IR transmitter busy-waits while it sends a frame,
+// which can take around 100 ms, so it runs below the IO tasks on the core without audio,
+// where it only holds up the loop. The IO tasks are brief, so they barely stretch its
+// timings.
+struct task_plan {
+    task_settings isr = {1, 4};
+    task_settings knob = {1, 4};
+    task_settings ir_rx = {1, 3};
+    task_settings ir_tx = {1, 3};
+    task_settings animation = {0, 2};
+    task_settings speaker = {0, 5};
+    task_settings recording = {0, 5};
+};
+
+namespace YTasks {
+
+// Tasks are created with statically allocated stacks, so nothing is taken from the heap
+// when they start. Stacks can be up to max_stack_size bytes. A task that exits by itself
+// uses up one of the max_tasks slots for good, so short lived tasks should be ended with
+// stop() instead, which frees their slot.
+static constexpr int max_tasks = 10;
+static constexpr uint32_t max_stack_size = 4096;
+
+// Sets the plan used for tasks created after this call
+void set_plan(const task_plan &plan);
+const task_plan &get_plan();
+
+// Creates a task with the given settings and adds it to the task report. Returns false
+// if the task couldn't be created, which only happens if there have been too many tasks
+// or the stack is too big.
+bool create(TaskFunction_t function, const char *name, uint32_t stack_size, void *arg,
+            const task_settings &settings, TaskHandle_t *handle = NULL);
+
+// Removes the calling task from the task report and deletes it. Its slot isn't freed.
+void exit();
+
+// Deletes a task once it is waiting for a notification that never comes, such as in
+// ulTaskNotifyTake(pdTRUE, portMAX_DELAY), and frees its slot for another task. The task
+// must not be woken again, and must not be waiting on anything else while its work is
+// unfinished. Must not be called by the task itself.
+void stop(TaskHandle_t handle);
+
+// Prints each library task's core, priority, stack use and (if FreeRTOS run time stats
+// are enabled) the share of CPU time it has used since the last report
+void print_report(Print &out = Serial);
+
+}; // namespace YTasks
+
+#endif /* YTASKS_H */
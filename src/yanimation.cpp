@@ -0,0 +1,301 @@
+#include "yanimation.h"
+#include "ytasks.h"
+
+#include <Arduino.h>
+
+namespace YAnimation {
+
+///////////////////////////////// Configuration Constants //////////////////////
+
+static const uint8_t default_frame_rate = 50;
+
+// Length of the fading tail behind the chase dot, in LEDs
+static const int chase_tail_length = 3;
+
+// LED buffer and how to commit it
+static CRGB *leds;
+static int num_leds;
+static SemaphoreHandle_t leds_mutex;
+static commit_function commit;
+static void *commit_arg;
+
+// Running animations. A handle is the slot index plus max_animations times the slot's
+// generation, which goes up each time the slot is used.
+typedef struct {
+    bool active;
+    uint16_t generation;
+    led_animation animation;
+    uint32_t start_ms;
+} slot_t;
+
+static slot_t slots[max_animations];
+static SemaphoreHandle_t slots_mutex;
+static StaticSemaphore_t slots_mutex_buffer;
+static TaskHandle_t animation_task_handle;
+static TickType_t frame_ticks = pdMS_TO_TICKS(1000 / default_frame_rate);
+
+//////////////////////////// Private Function Prototypes ///////////////////////
+static void animation_task(void *params);
+static bool render(const led_animation &animation, uint32_t elapsed_ms);
+static slot_t *find_slot(int handle);
+
+////////////////////////////// Public Functions ///////////////////////////////
+void setup(CRGB *led_buffer, int led_count, SemaphoreHandle_t led_mutex, commit_function commit_fn,
+           void *arg) {
+    leds = led_buffer;
+    num_leds = led_count;
+    leds_mutex = led_mutex;
+    commit = commit_fn;
+    commit_arg = arg;
+
+    slots_mutex = xSemaphoreCreateMutexStatic(&slots_mutex_buffer);
+    YTasks::create(animation_task, "animation_task", 4096, NULL, YTasks::get_plan().animation,
+                   &animation_task_handle);
+}
+
+int start(const led_animation &animation) {
+    if (animation.first_led < 1 || animation.last_led > num_leds ||
+        animation.first_led > animation.last_led) {
+        Serial.printf("ERROR: LED range %d-%d out of range (1-%d)\n", animation.first_led,
+                      animation.last_led, num_leds);
+        return -1;
+    }
+
+    if (animation.effect == led_effect::keyframes &&
+        (animation.keyframes == NULL || animation.num_keyframes == 0)) {
+        Serial.println("ERROR: Keyframe animation has no keyframes");
+        return -1;
+    }
+
+    if (animation.effect != led_effect::keyframes && animation.period_ms == 0) {
+        Serial.println("ERROR: Animation period must be greater than 0");
+        return -1;
+    }
+
+    int handle = -1;
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    for (int i = 0; i < max_animations; i++) {
+        if (!slots[i].active) {
+            slots[i].animation = animation;
+            slots[i].start_ms = millis();
+            slots[i].active = true;
+            slots[i].generation++;
+            handle = slots[i].generation * max_animations + i;
+            break;
+        }
+    }
+    xSemaphoreGive(slots_mutex);
+
+    if (handle < 0) {
+        Serial.printf("ERROR: Too many LED animations (max %d)\n", max_animations);
+        return -1;
+    }
+
+    // Wake up the animation task in case it was idle
+    xTaskNotifyGive(animation_task_handle);
+
+    return handle;
+}
+
+void stop(int handle) {
+    if (slots_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    slot_t *slot = find_slot(handle);
+    if (slot) {
+        slot->active = false;
+    }
+    xSemaphoreGive(slots_mutex);
+}
+
+void stop_all() {
+    if (slots_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    for (slot_t &slot : slots) {
+        slot.active = false;
+    }
+    xSemaphoreGive(slots_mutex);
+}
+
+bool is_running(int handle) {
+    if (slots_mutex == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    bool running = find_slot(handle) != NULL;
+    xSemaphoreGive(slots_mutex);
+    return running;
+}
+
+void set_frame_rate(uint8_t frames_per_second) {
+    if (frames_per_second < 1) {
+        frames_per_second = 1;
+    }
+    frame_ticks = pdMS_TO_TICKS(1000 / frames_per_second);
+    if (frame_ticks == 0) {
+        frame_ticks = 1;
+    }
+}
+
+////////////////////////////// Private Functions ///////////////////////////////
+
+void animation_task(void *params) {
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        bool any_active = false;
+        uint32_t now_ms = millis();
+
+        // Later animations are drawn on top of earlier ones
+        xSemaphoreTake(slots_mutex, portMAX_DELAY);
+        xSemaphoreTake(leds_mutex, portMAX_DELAY);
+        for (slot_t &slot : slots) {
+            if (!slot.active) {
+                continue;
+            }
+            if (!render(slot.animation, now_ms - slot.start_ms)) {
+                slot.active = false;
+            }
+            any_active = true;
+        }
+        xSemaphoreGive(leds_mutex);
+        xSemaphoreGive(slots_mutex);
+
+        if (any_active) {
+            commit(commit_arg);
+            vTaskDelayUntil(&last_wake, frame_ticks);
+        } else {
+            // Nothing to draw, so sleep until an animation is started
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            last_wake = xTaskGetTickCount();
+        }
+    }
+}
+
+// Returns the running animation a handle names, or NULL. Called with slots_mutex held.
+slot_t *find_slot(int handle) {
+    if (handle < 0) {
+        return NULL;
+    }
+
+    slot_t &slot = slots[handle % max_animations];
+    if (!slot.active || slot.generation != (uint16_t)(handle / max_animations)) {
+        return NULL;
+    }
+    return &slot;
+}
+
+// Returns the position within the current cycle as a fraction of 65536, and whether the
+// animation has finished (only possible when it doesn't loop).
+static uint16_t cycle_phase(uint32_t elapsed_ms, uint32_t period_ms, bool loop, bool &done) {
+    done = !loop && elapsed_ms >= period_ms;
+    if (done) {
+        return 0xFFFF;
+    }
+    return ((uint64_t)(elapsed_ms % period_ms) << 16) / period_ms;
+}
+
+// Sets color to the keyframe color for an LED at time t, blending between the keyframes
+// either side. LEDs with no keyframes are left unchanged.
+static void keyframe_color(const led_animation &animation, uint16_t led, uint32_t t,
+                           CRGB &color) {
+    const led_keyframe *before = NULL;
+    const led_keyframe *after = NULL;
+
+    for (int i = 0; i < animation.num_keyframes; i++) {
+        const led_keyframe &keyframe = animation.keyframes[i];
+        if (keyframe.led != 0 && keyframe.led != led) {
+            continue;
+        }
+        if (keyframe.time_ms <= t) {
+            before = &keyframe;
+        } else {
+            after = &keyframe;
+            break;
+        }
+    }
+
+    if (before && after) {
+        uint32_t span = after->time_ms - before->time_ms;
+        color = blend(before->color, after->color, ((t - before->time_ms) * 255) / span);
+    } else if (before) {
+        color = before->color;
+    } else if (after) {
+        color = after->color;
+    }
+}
+
+// Draws one frame of an animation. Returns false once the animation has finished.
+bool render(const led_animation &animation, uint32_t elapsed_ms) {
+    CRGB *first = &leds[animation.first_led - 1];
+    int count = animation.last_led - animation.first_led + 1;
+    bool done = false;
+
+    switch (animation.effect) {
+    case led_effect::fade: {
+        // A looping fade runs forward then backward, so each cycle is two periods long
+        uint16_t phase;
+        if (animation.loop) {
+            phase = cycle_phase(elapsed_ms, animation.period_ms * 2, true, done);
+            phase = (phase < 0x8000) ? phase * 2 : (0xFFFF - phase) * 2;
+        } else {
+            phase = cycle_phase(elapsed_ms, animation.period_ms, false, done);
+        }
+        fill_solid(first, count, blend(animation.color, animation.color2, phase >> 8));
+        break;
+    }
+
+    case led_effect::chase: {
+        uint16_t phase = cycle_phase(elapsed_ms, animation.period_ms, animation.loop, done);
+        int head = ((uint32_t)phase * count) >> 16;
+        fill_solid(first, count, animation.color2);
+        for (int i = 0; i <= chase_tail_length && i < count; i++) {
+            int led = (head - i + count) % count;
+            uint8_t amount = 255 - (i * 255) / (chase_tail_length + 1);
+            first[led] = blend(animation.color2, animation.color, amount);
+        }
+        break;
+    }
+
+    case led_effect::rainbow: {
+        uint16_t phase = cycle_phase(elapsed_ms, animation.period_ms, animation.loop, done);
+        uint8_t hue = phase >> 8;
+        for (int i = 0; i < count; i++) {
+            first[i] = CHSV(hue + (i * 256) / count, 255, 255);
+        }
+        break;
+    }
+
+    case led_effect::breathe: {
+        // Start dark, peak halfway through the cycle
+        uint16_t phase = cycle_phase(elapsed_ms, animation.period_ms, animation.loop, done);
+        uint8_t level = cubicwave8(phase >> 8);
+        CRGB color = animation.color;
+        color.nscale8_video(level);
+        fill_solid(first, count, color);
+        break;
+    }
+
+    case led_effect::keyframes: {
+        // The list is in time order, so the last keyframe marks the end of the cycle
+        uint32_t length_ms = animation.keyframes[animation.num_keyframes - 1].time_ms;
+        done = length_ms == 0 || (!animation.loop && elapsed_ms >= length_ms);
+        uint32_t t = done ? length_ms : elapsed_ms % length_ms;
+
+        for (int i = 0; i < count; i++) {
+            keyframe_color(animation, animation.first_led + i, t, first[i]);
+        }
+        break;
+    }
+    }
+
+    return !done;
+}
+
+}; // namespace YAnimation
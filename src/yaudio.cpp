@@ -1,7 +1,17 @@
 #include "yaudio.h"
+#include "yfiles.h"
+#include "yfrontend.h"
+#include "ygain.h"
+#include "ymidi.h"
+#include "ynotes.h"
+#include "yprofile.h"
+#include "yresample.h"
+#include "ysynth.h"
+#include "ytasks.h"
 
 #include <Arduino.h>
 #include <AudioTools/AudioCodecs/CodecMP3Helix.h>
+#include <esp_heap_caps.h>
 #include <AudioTools/AudioCodecs/CodecWAV.h>
 #include <FS.h>
 #include <SD.h>
@@ -11,87 +21,377 @@ namespace YAudio {
 ///////////////////////////////// Configuration Constants //////////////////////
 
 static const int MAX_NOTES_IN_BUFFER = 4000;
+static const size_t MAX_TONE_BLOCK_SAMPLES = 512;
 
-// This is the sequence of notes to play
-static std::string notes;
+// Characters of a notes file held in the notes buffer at once. More is read once less
+// than half of this is left, so there are always a few notes parsed ahead.
+static const size_t NOTES_FILE_WINDOW = 256;
 
-// Notes state
-static int beats_per_minute;
-static int octave;
-static int volume_notes;
+// MIDI notes are played at up to this amplitude, depending on how hard they are struck.
+// It leaves room for a chord on every voice without clipping much.
+static const uint16_t MIDI_VOICE_AMPLITUDE = 8000;
+static const envelope_t MIDI_ENVELOPE = {5, 300, 60, 100};
+
+// MIDI channel reserved for drums, which can't be played with sine waves
+static const uint8_t MIDI_DRUM_CHANNEL = 9;
+
+// Number of memory clips that can exist at once, and the samples moved at a time when
+// recording or playing one
+static const int MAX_CLIPS = 8;
+static const size_t CLIP_BLOCK_SAMPLES = 256;
+
+// Pitch shift range for clips, in half steps
+static const int MAX_CLIP_SEMITONES = 24;
 
+// The speaker always runs at this rate and format. Sound files at other rates are
+// resampled on the way to it, so I2S never has to be restarted.
+static AudioInfo speakerInfo(44100, 1, 16);
+
+// I2S DMA buffer layout for each audio_latency, in enum order, and how far the audio
+// task's priority is moved from the one in the task plan. Small buffers run dry sooner,
+// so the low latency task is raised to refill them before other work on its core.
 typedef struct {
-    unsigned int frequency;
-    unsigned int duration;
-} note_t;
+    int buffer_count;
+    int buffer_size;
+    int priority_offset;
+} latency_profile_t;
+
+static const latency_profile_t latency_profiles[] = {
+    {4, 128, 1},   // low
+    {6, 512, 0},   // normal
+    {8, 1024, -1}, // relaxed
+};
+
+// Latency measurement. trigger_us is when playback was last started, or 0 once the
+// first samples have reached the driver.
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t trigger_us = 0;
+static audio_latency_stats latency_stats = {0, 0, 0, 0};
+
+// This is the sequence of notes to play. Notes are parsed from notes_start, and new
+// notes are added at notes_end, first moving what's left to the front if needed.
+static char notes[MAX_NOTES_IN_BUFFER];
+static size_t notes_start = 0;
+static size_t notes_end = 0;
+
+// Notes state
+static NoteParser note_parser;
+
+// Notes file being streamed into the notes buffer. streaming_notes is true until all of
+// it has been read.
+static File notes_file;
+static bool streaming_notes = false;
 
 // Note playing task
 static TaskHandle_t play_speaker_task_handle;
 static SemaphoreHandle_t notes_mutex;
+static StaticSemaphore_t notes_mutex_buffer;
 
 // General stream variables
 static StreamCopy copier;
 
+// Writes to the speaker, counting underruns: times the I2S DMA buffers ran dry in the
+// middle of a sound because audio wasn't written in time. The driver doesn't report
+// these, so this keeps track of when the audio written so far will have finished
+// playing. A write that comes after that found the buffers empty.
+class SpeakerOutput : public Print {
+  public:
+    explicit SpeakerOutput(Print &out) : out(out) {}
+
+    void configure(uint32_t new_bytes_per_second, uint32_t new_queue_us,
+                   uint32_t new_buffer_us) {
+        bytes_per_second = new_bytes_per_second;
+        queue_us = new_queue_us;
+        buffer_us = new_buffer_us;
+    }
+
+    // Starts a new sound. The speaker is meant to be silent until it starts.
+    void begin() { playing_until_us = 0; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t *data, size_t len) override {
+        int64_t start_us = esp_timer_get_time();
+        if (playing_until_us != 0 && start_us > playing_until_us) {
+            YPROFILE_COUNT(audio_underruns, 1);
+        }
+
+        size_t written = out.write(data, len);
+        int64_t end_us = esp_timer_get_time();
+
+        // A write that had to wait for room returns with the buffers full, which also
+        // corrects for drift between the I2S clock and the timer
+        if (end_us - start_us > buffer_us / 2) {
+            playing_until_us = end_us + queue_us;
+        } else {
+            playing_until_us = std::max(playing_until_us, start_us) +
+                               (int64_t)written * 1000000 / bytes_per_second;
+        }
+        return written;
+    }
+
+  private:
+    Print &out;
+    uint32_t bytes_per_second = 1;
+    uint32_t queue_us = 0;
+    uint32_t buffer_us = 0;
+    int64_t playing_until_us = 0;
+};
+
+// Converts whatever is written to it to the speaker's rate, mixes it down to mono, and
+// applies the volume. 8-bit audio is widened to 16 bits first.
+class ResampleStream : public AudioStream {
+  public:
+    ResampleStream(Print &out, AudioInfo out_info, Gain &gain)
+        : out(out), out_info(out_info), gain(gain) {}
+
+    // Starts a new stream, so nothing is carried over from the last one even if it had
+    // the same format
+    bool begin() override {
+        resampler.reset();
+        staged_bytes = 0;
+        return true;
+    }
+
+    void setAudioInfo(AudioInfo in_info) override {
+        if (in_info == info) {
+            return;
+        }
+        AudioStream::setAudioInfo(in_info);
+
+        if (in_info.bits_per_sample != 8 && in_info.bits_per_sample != 16) {
+            Serial.printf("ERROR: %d-bit audio is not supported\n", in_info.bits_per_sample);
+        }
+        resampler.configure(in_info.sample_rate, out_info.sample_rate, in_info.channels);
+        staged_bytes = 0;
+    }
+
+    size_t write(const uint8_t *data, size_t len) override {
+        if ((info.bits_per_sample != 8 && info.bits_per_sample != 16) || info.channels < 1 ||
+            info.channels > Resampler::max_channels) {
+            return len;
+        }
+
+        size_t frame_bytes = info.channels * sizeof(int16_t);
+        size_t pos = 0;
+        while (pos < len) {
+            // Stage the input so frames are aligned, keeping any partial frame from the
+            // last write at the front
+            size_t n;
+            if (info.bits_per_sample == 8) {
+                // 8-bit samples are unsigned
+                n = std::min(len - pos, (sizeof(staged) - staged_bytes) / sizeof(int16_t));
+                int16_t *dest = (int16_t *)((uint8_t *)staged + staged_bytes);
+                for (size_t i = 0; i < n; i++) {
+                    dest[i] = (data[pos + i] - 128) * 256;
+                }
+                staged_bytes += n * sizeof(int16_t);
+            } else {
+                n = std::min(len - pos, sizeof(staged) - staged_bytes);
+                memcpy((uint8_t *)staged + staged_bytes, data + pos, n);
+                staged_bytes += n;
+            }
+            pos += n;
+
+            size_t frames = staged_bytes / frame_bytes;
+            size_t done = 0;
+            while (done < frames) {
+                size_t consumed;
+                size_t samples = resampler.process(staged + done * info.channels, frames - done,
+                                                   converted, sizeof(converted) / 2, consumed);
+                gain.process(converted, samples);
+                write_all(converted, samples * sizeof(int16_t));
+                done += consumed;
+            }
+
+            size_t used = done * frame_bytes;
+            memmove(staged, (uint8_t *)staged + used, staged_bytes - used);
+            staged_bytes -= used;
+        }
+
+        return len;
+    }
+
+  private:
+    Print &out;
+    AudioInfo out_info;
+    Gain &gain;
+    Resampler resampler;
+    int16_t staged[256];
+    size_t staged_bytes = 0;
+    int16_t converted[512];
+
+    void write_all(const int16_t *samples, size_t len) {
+        const uint8_t *pos = (const uint8_t *)samples;
+        while (len > 0) {
+            size_t written = out.write(pos, len);
+            if (written == 0) {
+                delay(1);
+                continue;
+            }
+            pos += written;
+            len -= written;
+        }
+    }
+};
+
+// Reads from the microphone and cleans up the audio on the way, so everything that reads
+// the microphone gets the same processed audio
+class MicStream : public AudioStream {
+  public:
+    MicStream(Stream &in, MicFrontEnd &front_end) : in(in), front_end(front_end) {}
+
+    int available() override { return in.available(); }
+
+    size_t readBytes(uint8_t *data, size_t len) override {
+        size_t read = in.readBytes(data, len);
+        {
+            YPROFILE_SCOPE(mic_process);
+            front_end.process((int16_t *)data, read / sizeof(int16_t));
+        }
+        return read;
+    }
+
+  private:
+    Stream &in;
+    MicFrontEnd &front_end;
+};
+
 // Variables for speaker
 static I2SStream speakerOut;
-static PoppingSoundRemover<int16_t> poppingRemover(1, true, true);
-
-// Variables for tone generation
-static AudioInfo sineInfo(16000, 1, 16);
-static SineWaveGenerator<int16_t> sineWave(16000);
-static GeneratedSoundStream<int16_t> toneStream(sineWave);
+static SpeakerOutput speakerWriter(speakerOut);
+static Gain speakerGain;
+static ResampleStream speakerResampler(speakerWriter, speakerInfo, speakerGain);
+
+// Variables for tone generation. Notes are rendered a block at a time, one DMA buffer long.
+static Synth synth;
+static int16_t tone_block[MAX_TONE_BLOCK_SAMPLES];
+static size_t tone_block_samples = 0;
 static bool playing_tones = false;
 
+// Variables for MIDI playback. midi_voice_keys holds the channel and note played by each
+// synth voice, or -1, so note offs can find their voice. The reader is used with
+// notes_mutex held.
+static File midi_file;
+static MidiReader midi_reader;
+static int midi_voice_keys[Synth::max_voices];
+static bool playing_midi = false;
+
 // Variables for audio file decoding
 static File sound_file;
-static VolumeStream speakerVolume(speakerOut);
-static EncodedAudioStream wav_decoder(&speakerVolume, new WAVDecoder());
-static EncodedAudioStream mp3_decoder(&speakerVolume, new MP3DecoderHelix());
+static WAVDecoder wav_codec;
+static MP3DecoderHelix mp3_codec;
+static EncodedAudioStream wav_decoder(&speakerResampler, &wav_codec);
+static EncodedAudioStream mp3_decoder(&speakerResampler, &mp3_codec);
 static bool playing_file = false;
 
 // Variables for microphone
 static File speaker_recording_file;
 static AudioInfo micInfo(44100, 1, 16);
 static I2SStream micIn;
-static VolumeStream micVolume(micIn);
+static MicFrontEnd micFrontEnd;
+static MicStream micStream(micIn, micFrontEnd);
+
+// Memory clips. Samples are mono 16-bit at the microphone's rate, kept in PSRAM if the
+// board has it. The speaker task holds clips_mutex while it plays a clip, so a clip
+// isn't freed under it.
+typedef struct {
+    int16_t *samples; // NULL when the slot is free
+    size_t capacity;
+    volatile size_t length;
+} clip_t;
+
+static clip_t clips[MAX_CLIPS];
+static SemaphoreHandle_t clips_mutex = NULL;
+static StaticSemaphore_t clips_mutex_buffer;
+static int recording_clip = -1;
+
+// Clip to play, and how. Each play_clip call bumps clip_trigger, so the speaker task can
+// tell a new request from the one it is playing.
+static int clip_to_play = -1;
+static bool clip_loop = false;
+static uint32_t clip_rate = 44100;
+static volatile uint32_t clip_trigger = 0;
+static bool playing_clip = false;
 
 // Variables for recording
-static EncodedAudioStream wav_encoder(&speaker_recording_file, new WAVEncoder());
+static WAVEncoder wav_encoder_codec;
+static EncodedAudioStream wav_encoder(&speaker_recording_file, &wav_encoder_codec);
 static bool recording_audio = false;
 static bool done_recording_audio = true;
 
+// Recording task, started once the microphone is set up and woken for each recording
+static TaskHandle_t recording_task_handle = NULL;
+
 //////////////////////////// Private Function Prototypes ///////////////////////
 // Local private functions
 static void play_speaker_task(void *params);
-static void recording_audio_task(void *params);
+static void recording_task(void *params);
+static void record_to_file();
+static void record_to_clip();
+static void create_clips_mutex();
+static bool is_valid_clip(int clip);
+static void play_clip_samples();
 static note_t parse_next_note();
-static void set_note_defaults();
+static bool read_notes_file(bool force);
+static void play_tone_block(size_t samples);
+static void finish_tones();
+static void play_midi_event(const midi_event_t &event);
+static size_t read_midi_file(void *context, uint32_t offset, uint8_t *buffer, size_t len);
+static task_settings profile_settings(const task_settings &planned,
+                                      const latency_profile_t &profile);
+static void start_latency_measurement();
+static void finish_latency_measurement();
 
 ////////////////////////////// Public Functions ///////////////////////////////
-bool setup_speaker(int ws_pin, int bck_pin, int data_pin, int i2s_port) {
-    set_note_defaults();
+bool setup_speaker(int ws_pin, int bck_pin, int data_pin, int i2s_port,
+                   audio_latency latency) {
+    const latency_profile_t &profile = latency_profiles[static_cast<int>(latency)];
+    note_parser.reset();
 
     Serial.println("starting I2S...");
     auto config = speakerOut.defaultConfig(TX_MODE);
-    config.copyFrom(sineInfo);
+    config.copyFrom(speakerInfo);
     config.pin_ws = ws_pin;
     config.pin_bck = bck_pin;
     config.pin_data = data_pin;
     config.port_no = i2s_port;
+    config.buffer_count = profile.buffer_count;
+    config.buffer_size = profile.buffer_size;
 
     speakerOut.begin(config);
-    speakerVolume.begin(config);
+
+    // Copy one DMA buffer at a time, so a copy never waits on more than one buffer
+    copier.resize(profile.buffer_size);
+    synth.configure(speakerInfo.sample_rate);
+    tone_block_samples = std::min(profile.buffer_size / sizeof(int16_t), MAX_TONE_BLOCK_SAMPLES);
+
+    uint32_t bytes_per_second = speakerInfo.sample_rate * speakerInfo.channels * sizeof(int16_t);
+    latency_stats.dma_queue_us =
+        (uint64_t)profile.buffer_count * profile.buffer_size * 1000000 / bytes_per_second;
+    speakerWriter.configure(bytes_per_second, latency_stats.dma_queue_us,
+                            (uint64_t)profile.buffer_size * 1000000 / bytes_per_second);
+
+    // Decoders report each file's format to the resampler, not to the speaker
+    wav_decoder.addNotifyAudioChange(speakerResampler);
+    mp3_decoder.addNotifyAudioChange(speakerResampler);
 
     // Create the mutex for notes string
-    notes_mutex = xSemaphoreCreateMutex();
+    notes_mutex = xSemaphoreCreateMutexStatic(&notes_mutex_buffer);
+    create_clips_mutex();
 
     // Create task that will actually do the playing
-    xTaskCreate(play_speaker_task, "play_speaker_task", 4096, NULL, 1, &play_speaker_task_handle);
+    YTasks::create(play_speaker_task, "play_speaker_task", 4096, NULL,
+                   profile_settings(YTasks::get_plan().speaker, profile),
+                   &play_speaker_task_handle);
 
     return true;
 }
 
-bool setup_mic(int ws_pin, int data_pin, int i2s_port) {
+bool setup_mic(int ws_pin, int data_pin, int i2s_port, audio_latency latency,
+               const mic_settings &settings) {
+    const latency_profile_t &profile = latency_profiles[static_cast<int>(latency)];
+
     auto config = micIn.defaultConfig(RX_MODE);
     config.copyFrom(micInfo);
     config.signal_type = PDM;
@@ -100,24 +400,34 @@ bool setup_mic(int ws_pin, int data_pin, int i2s_port) {
     config.port_no = i2s_port;
     config.pin_ws = ws_pin;
     config.pin_data = data_pin;
-
-    auto volumeConfig = micVolume.defaultConfig();
-    volumeConfig.copyFrom(micInfo);
-    volumeConfig.allow_boost = true;
+    config.buffer_count = profile.buffer_count;
+    config.buffer_size = profile.buffer_size;
 
     micIn.begin(config);
-    micVolume.begin(volumeConfig);
+    create_clips_mutex();
+    micFrontEnd.configure(micInfo.sample_rate, settings.high_pass_hz, settings.agc,
+                          settings.agc_target_percent);
+
+    if (recording_task_handle == NULL) {
+        YTasks::create(recording_task, "recording_task", 4096, NULL,
+                       profile_settings(YTasks::get_plan().recording, profile),
+                       &recording_task_handle);
+    }
 
     return true;
 }
 
 bool start_recording(const std::string &filename) {
+    if (recording_task_handle == NULL) {
+        Serial.println("Error recording: microphone not set up.");
+        return false;
+    }
     if (recording_audio) {
         Serial.println("Already recording audio");
         return false;
     }
 
-    speaker_recording_file = SD.open(filename.c_str(), FILE_WRITE);
+    speaker_recording_file = YFiles::open_write(filename.c_str());
     if (!speaker_recording_file) {
         Serial.println("Error opening/creating file for recording.");
         return false;
@@ -127,29 +437,27 @@ bool start_recording(const std::string &filename) {
     recording_audio = true;
     done_recording_audio = false;
 
-    // Create the task to actually do the recording
-    xTaskCreate(recording_audio_task, "recording_audio_task", 4096, NULL, 1, NULL);
+    // Wake the task to actually do the recording
+    xTaskNotifyGive(recording_task_handle);
 
     return true;
 }
 
-void recording_audio_task(void *params) {
+// Records into speaker_recording_file until stopped. Called from the recording task.
+void record_to_file() {
+    micFrontEnd.reset();
     wav_encoder.begin(micInfo);
-    copier.begin(wav_encoder, micVolume);
+    copier.begin(wav_encoder, micStream);
 
     while (recording_audio) {
+        YPROFILE_SCOPE(audio_copy);
         copier.copy();
     }
 
     speaker_recording_file.flush();
+    YFiles::update_size(speaker_recording_file.path(), speaker_recording_file.size());
     speaker_recording_file.close();
     wav_encoder.end();
-
-    // Indicate to the main task that we are done
-    done_recording_audio = true;
-
-    // This task is done so delete itself
-    vTaskDelete(NULL);
 }
 
 void stop_recording() {
@@ -164,25 +472,146 @@ void stop_recording() {
 
 bool is_recording() { return recording_audio; }
 
-void set_recording_gain(uint8_t new_gain) { micVolume.setVolume(new_gain); }
+int start_clip_recording(uint32_t max_duration_ms) {
+    if (recording_task_handle == NULL) {
+        Serial.println("Error recording clip: microphone not set up.");
+        return -1;
+    }
+    if (recording_audio) {
+        Serial.println("Already recording audio");
+        return -1;
+    }
+
+    int clip = -1;
+    for (int i = 0; i < MAX_CLIPS && clip < 0; i++) {
+        if (clips[i].samples == NULL) {
+            clip = i;
+        }
+    }
+    if (clip < 0) {
+        Serial.printf("Error recording clip: too many clips (max %d).\n", MAX_CLIPS);
+        return -1;
+    }
+
+    // Use PSRAM if there is any, leaving internal RAM for everything else
+    size_t capacity = (uint64_t)max_duration_ms * micInfo.sample_rate / 1000;
+    size_t bytes = capacity * sizeof(int16_t);
+    int16_t *samples = (int16_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (samples == NULL) {
+        samples = (int16_t *)heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (capacity == 0 || samples == NULL) {
+        heap_caps_free(samples);
+        Serial.printf("Error recording clip: not enough memory for %lu ms.\n",
+                      (unsigned long)max_duration_ms);
+        return -1;
+    }
+
+    clips[clip].samples = samples;
+    clips[clip].capacity = capacity;
+    clips[clip].length = 0;
+
+    // Set up initial state
+    recording_clip = clip;
+    recording_audio = true;
+    done_recording_audio = false;
+
+    // Wake the task to actually do the recording
+    xTaskNotifyGive(recording_task_handle);
+
+    return clip;
+}
+
+bool play_clip(int clip, bool loop, int semitones) {
+    if (!is_valid_clip(clip) || clip == recording_clip) {
+        Serial.println("Error playing clip: no such clip, or it is being recorded.");
+        return false;
+    }
+
+    // Whether notes or wave is running, stop it
+    stop_speaker();
+
+    // The clip is resampled as if it had been recorded at a different rate, which plays
+    // it faster and higher, or slower and lower
+    semitones = std::max(-MAX_CLIP_SEMITONES, std::min(semitones, MAX_CLIP_SEMITONES));
+    clip_rate = micInfo.sample_rate * powf(2.0f, semitones / 12.0f);
+    clip_to_play = clip;
+    clip_loop = loop;
+    clip_trigger++;
+
+    start_latency_measurement();
+    playing_clip = true;
+    xTaskNotifyGive(play_speaker_task_handle);
+
+    return true;
+}
+
+uint32_t get_clip_duration_ms(int clip) {
+    if (!is_valid_clip(clip)) {
+        return 0;
+    }
+    return (uint64_t)clips[clip].length * 1000 / micInfo.sample_rate;
+}
+
+void delete_clip(int clip) {
+    if (!is_valid_clip(clip)) {
+        return;
+    }
+
+    if (clip == recording_clip) {
+        stop_recording();
+    }
+    if (playing_clip && clip == clip_to_play) {
+        stop_speaker();
+    }
+
+    // Wait for the speaker task to let go of it
+    xSemaphoreTake(clips_mutex, portMAX_DELAY);
+    heap_caps_free(clips[clip].samples);
+    clips[clip].samples = NULL;
+    clips[clip].capacity = 0;
+    clips[clip].length = 0;
+    xSemaphoreGive(clips_mutex);
+}
+
+void set_recording_gain(uint8_t new_gain) { micFrontEnd.set_gain(new_gain * Gain::unity); }
 
 I2SStream &get_speaker_stream() { return speakerOut; }
 
 I2SStream &get_mic_stream() { return micIn; }
 
+AudioStream &get_processed_mic_stream() { return micStream; }
+
 bool add_notes(const std::string &new_notes) {
-    if ((notes.length() + new_notes.length()) > MAX_NOTES_IN_BUFFER) {
+    xSemaphoreTake(notes_mutex, portMAX_DELAY);
+    if (streaming_notes) {
+        xSemaphoreGive(notes_mutex);
+        Serial.println("Error adding notes: a notes file is playing.");
+        return false;
+    }
+
+    size_t pending = notes_end - notes_start;
+    if ((pending + new_notes.length()) > MAX_NOTES_IN_BUFFER) {
+        xSemaphoreGive(notes_mutex);
         Serial.printf("Error adding notes: too many notes in buffer (%d + %d > %d).\n",
-                      new_notes.length(), notes.length(), MAX_NOTES_IN_BUFFER);
+                      (int)new_notes.length(), (int)pending, MAX_NOTES_IN_BUFFER);
         return false;
     }
 
     // Append the new notes to the existing notes
-    xSemaphoreTake(notes_mutex, portMAX_DELAY);
-    notes += new_notes;
+    if (notes_end + new_notes.length() > MAX_NOTES_IN_BUFFER) {
+        memmove(notes, notes + notes_start, pending);
+        notes_start = 0;
+        notes_end = pending;
+    }
+    memcpy(notes + notes_end, new_notes.data(), new_notes.length());
+    notes_end += new_notes.length();
     xSemaphoreGive(notes_mutex);
 
     // Signal we need to play the notes
+    if (!playing_tones) {
+        start_latency_measurement();
+    }
     playing_tones = true;
     xTaskNotifyGive(play_speaker_task_handle);
 
@@ -192,23 +621,36 @@ bool add_notes(const std::string &new_notes) {
 void stop_speaker() {
     // Update flags
     playing_tones = false;
+    playing_midi = false;
+    playing_clip = false;
     playing_file = false;
 
     // Clear out all pending notes
     xSemaphoreTake(notes_mutex, portMAX_DELAY);
-    notes.clear();
+    notes_start = notes_end = 0;
+    streaming_notes = false;
+    YFiles::release(notes_file);
+    YFiles::release(midi_file);
     xSemaphoreGive(notes_mutex);
 
     copier.end();
 }
 
-bool is_playing() { return playing_tones || playing_file; }
+bool is_playing() { return playing_tones || playing_midi || playing_clip || playing_file; }
+
+audio_latency_stats get_latency_stats() {
+    portENTER_CRITICAL(&latency_lock);
+    audio_latency_stats stats = latency_stats;
+    portEXIT_CRITICAL(&latency_lock);
+    return stats;
+}
 
 bool play_sound_file(const std::string &filename) {
     // Whether notes or wave is running, stop it
     stop_speaker();
 
-    sound_file = SD.open(filename.c_str());
+    YFiles::release(sound_file);
+    sound_file = YFiles::open_read(filename.c_str());
     if (!sound_file) {
         Serial.printf("Error opening file: %s\n", filename.c_str());
         return false;
@@ -233,222 +675,406 @@ bool play_sound_file(const std::string &filename) {
         return false;
     }
 
+    start_latency_measurement();
     playing_file = true;
     xTaskNotifyGive(play_speaker_task_handle);
 
     return true;
 }
 
-////////////////////////////// Private Functions ///////////////////////////////
+bool play_notes_file(const std::string &filename) {
+    // Whether notes or wave is running, stop it
+    stop_speaker();
+
+    File file = YFiles::open_read(filename.c_str());
+    if (!file) {
+        Serial.printf("Error opening file: %s\n", filename.c_str());
+        return false;
+    }
+
+    xSemaphoreTake(notes_mutex, portMAX_DELAY);
+    notes_file = file;
+    streaming_notes = true;
+    note_parser.reset();
+    read_notes_file(true);
+    xSemaphoreGive(notes_mutex);
+
+    start_latency_measurement();
+    playing_tones = true;
+    xTaskNotifyGive(play_speaker_task_handle);
 
-void set_note_defaults() {
-    beats_per_minute = 120;
-    octave = 5;
-    volume_notes = 5;
+    return true;
 }
 
-note_t parse_next_note() {
-    static float note_freq;
-    static float duration_s;
+bool play_midi_file(const std::string &filename) {
+    // Whether notes or wave is running, stop it
+    stop_speaker();
 
-    while (notes.length()) {
-        // If first character is white space, remove it and continue
-        if (isspace(notes[0])) {
-            notes.erase(0, 1);
-            continue;
+    File file = YFiles::open_read(filename.c_str());
+    if (!file) {
+        Serial.printf("Error opening file: %s\n", filename.c_str());
+        return false;
+    }
+
+    xSemaphoreTake(notes_mutex, portMAX_DELAY);
+    midi_file = file;
+    bool ok = midi_reader.begin(read_midi_file, &midi_file);
+    xSemaphoreGive(notes_mutex);
+
+    if (!ok) {
+        Serial.printf("Error reading MIDI file: %s\n", filename.c_str());
+        return false;
+    }
+
+    start_latency_measurement();
+    playing_midi = true;
+    xTaskNotifyGive(play_speaker_task_handle);
+
+    return true;
+}
+
+////////////////////////////// Private Functions ///////////////////////////////
+
+// Called with notes_mutex held
+note_t parse_next_note() {
+    note_t note = {0, 0, 0, default_envelope};
+    read_notes_file(false);
+
+    while (true) {
+        const char *text = notes + notes_start;
+        size_t len = notes_end - notes_start;
+        size_t consumed;
+
+        NoteParser::result result =
+            note_parser.parse(text, len, note, consumed, streaming_notes);
+        if (result == NoteParser::syntax_error) {
+            Serial.printf("Syntax error in notes: %.*s\n", (int)(len - consumed), text + consumed);
+            notes_start = notes_end = 0;
+            streaming_notes = false;
+            YFiles::release(notes_file);
+            return {0, 0, 0, default_envelope};
         }
 
-        // Octave
-        if (notes[0] == 'O' || notes[0] == 'o') {
-            int new_octave = notes[1] - '0';
-            if (new_octave >= 4 && new_octave <= 7) {
-                octave = new_octave;
-            }
-            notes.erase(0, 2);
-            continue;
+        notes_start += consumed;
+        if (notes_start == notes_end) {
+            notes_start = notes_end = 0;
         }
 
-        // Tempo
-        if (notes[0] == 'T' || notes[0] == 't') {
-            notes.erase(0, 1);
-            size_t pos;
-            int new_tempo = std::stoi(notes, &pos);
-            notes = notes.substr(pos);
-            if (new_tempo >= 40 && new_tempo <= 240) {
-                beats_per_minute = new_tempo;
+        // Keep reading until there is a whole note, or the file runs out
+        if (streaming_notes && result != NoteParser::note_found) {
+            if (!read_notes_file(true) && streaming_notes) {
+                Serial.println("Syntax error in notes: note or command too long");
+                notes_start = notes_end = 0;
+                streaming_notes = false;
+                YFiles::release(notes_file);
+                return {0, 0, 0, default_envelope};
             }
             continue;
         }
 
-        // Reset
-        if (notes[0] == '!') {
-            set_note_defaults();
-            notes.erase(0, 1);
-            continue;
-        }
+        return note;
+    }
+}
 
-        // Volume
-        if (notes[0] == 'V' || notes[0] == 'v') {
-            notes.erase(0, 1);
-            size_t pos;
-            int new_volume = std::stoi(notes, &pos);
-            notes = notes.substr(pos);
-            if (new_volume >= 1 && new_volume <= 10) {
-                volume_notes = new_volume;
-            }
-            continue;
+// Tops up the notes buffer from the notes file, if it is running low or force is set.
+// Returns true if anything was read. Called with notes_mutex held.
+bool read_notes_file(bool force) {
+    size_t pending = notes_end - notes_start;
+    if (!streaming_notes || pending >= NOTES_FILE_WINDOW) {
+        return false;
+    }
+    if (!force && pending >= NOTES_FILE_WINDOW / 2) {
+        return false;
+    }
+
+    memmove(notes, notes + notes_start, pending);
+    notes_start = 0;
+    notes_end = pending;
+
+    size_t read = notes_file.read((uint8_t *)notes + notes_end, NOTES_FILE_WINDOW - pending);
+    notes_end += read;
+
+    if (notes_file.available() == 0) {
+        streaming_notes = false;
+        YFiles::release(notes_file);
+    }
+    return read > 0;
+}
+
+// Moves the planned priority by the profile's offset, keeping it above the idle task
+// and within the range FreeRTOS allows
+task_settings profile_settings(const task_settings &planned, const latency_profile_t &profile) {
+    int priority = (int)planned.priority + profile.priority_offset;
+    task_settings settings = planned;
+    settings.priority = (UBaseType_t)std::max(1, std::min(priority, configMAX_PRIORITIES - 1));
+    return settings;
+}
+
+void start_latency_measurement() {
+    portENTER_CRITICAL(&latency_lock);
+    trigger_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+// Called after each successful copy to the speaker, so it has to be cheap when there is
+// no measurement running
+void finish_latency_measurement() {
+    if (trigger_us == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&latency_lock);
+    if (trigger_us != 0) {
+        uint32_t elapsed = now - trigger_us;
+        latency_stats.last_us = elapsed;
+        if (elapsed > latency_stats.max_us) {
+            latency_stats.max_us = elapsed;
         }
+        latency_stats.count++;
+        trigger_us = 0;
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
 
-        duration_s = (60.0 / beats_per_minute); // Quarter note duration in seconds
-
-        // A-G regular notes
-        // R for rest
-        // z for end rest, which is added internally to stop speaker crackle at the end
-        if ((notes[0] >= 'A' && notes[0] <= 'G') || (notes[0] >= 'a' && notes[0] <= 'g') ||
-            notes[0] == 'R' || notes[0] == 'r' || notes[0] == 'z') {
-            switch (notes[0]) {
-            case 'A':
-            case 'a':
-                note_freq = 440.0;
-                break;
-            case 'B':
-            case 'b':
-                note_freq = 493.88;
-                break;
-            case 'C':
-            case 'c':
-                note_freq = 523.25;
-                break;
-            case 'D':
-            case 'd':
-                note_freq = 587.33;
-                break;
-            case 'E':
-            case 'e':
-                note_freq = 659.25;
-                break;
-            case 'F':
-            case 'f':
-                note_freq = 698.46;
-                break;
-            case 'G':
-            case 'g':
-                note_freq = 783.99;
-                break;
-            case 'z':
-                duration_s = 0.2;
-                // Fallthrough
-            case 'R':
-            case 'r':
-                note_freq = 0;
-                break;
-            }
+// Renders the next samples from the synth and writes them to the speaker
+void play_tone_block(size_t samples) {
+    {
+        YPROFILE_SCOPE(audio_copy);
+        synth.render(tone_block, samples);
+        speakerWriter.write((const uint8_t *)tone_block, samples * sizeof(int16_t));
+    }
+    finish_latency_measurement();
+}
+
+// Waits for a recording to be started and makes it, for as long as the board runs. The
+// task is never deleted, so its slot and stack are never handed to another task.
+void recording_task(void *params) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (recording_clip >= 0) {
+            record_to_clip();
+        } else {
+            record_to_file();
+        }
 
-            // Adjust frequency for octave
-            note_freq *= pow(2, octave - 4);
-            notes.erase(0, 1);
+        // Indicate to the main task that we are done
+        done_recording_audio = true;
+    }
+}
 
-            float dot_duration = duration_s;
+// Records into recording_clip until stopped or full. Called from the recording task.
+void record_to_clip() {
+    clip_t &clip = clips[recording_clip];
+    micFrontEnd.reset();
+
+    // Read straight into the clip until it is stopped or full
+    while (recording_audio && clip.length < clip.capacity) {
+        size_t samples = std::min(clip.capacity - clip.length, CLIP_BLOCK_SAMPLES);
+        size_t read;
+        {
+            YPROFILE_SCOPE(audio_copy);
+            read = micStream.readBytes((uint8_t *)(clip.samples + clip.length),
+                                       samples * sizeof(int16_t));
+        }
+        clip.length += read / sizeof(int16_t);
+    }
 
-            // Note modifiers
-            while (1) {
+    recording_audio = false;
+    recording_clip = -1;
+}
 
-                // Duration
-                if (isdigit(notes[0])) {
-                    size_t pos;
-                    int frac_duration = std::stoi(notes, &pos);
-                    notes = notes.substr(pos);
-                    if (frac_duration >= 1 && frac_duration <= 2000) {
-                        duration_s = duration_s * (4.0 / frac_duration);
-                    }
-                    continue;
-                }
+void create_clips_mutex() {
+    if (clips_mutex == NULL) {
+        clips_mutex = xSemaphoreCreateMutexStatic(&clips_mutex_buffer);
+    }
+}
 
-                // Dot
-                if (notes[0] == '.') {
-                    dot_duration /= 2;
-                    duration_s += dot_duration;
-                    notes.erase(0, 1);
-                    continue;
-                }
+bool is_valid_clip(int clip) {
+    return clip >= 0 && clip < MAX_CLIPS && clips[clip].samples != NULL;
+}
 
-                // Octave
-                if (notes[0] == '>') {
-                    note_freq *= 2;
-                    notes.erase(0, 1);
-                    continue;
-                }
-                if (notes[0] == '<') {
-                    note_freq /= 2;
-                    notes.erase(0, 1);
-                    continue;
-                }
+// Plays clip_to_play through the resampler until it ends, is stopped, or another clip is
+// asked for
+void play_clip_samples() {
+    uint32_t trigger = clip_trigger;
 
-                // Sharp/flat
-                if (notes[0] == '#' || notes[0] == '+' || notes[0] == '-') {
-                    if (notes[0] == '#' || notes[0] == '+') {
-                        note_freq *= pow(2, 1.0 / 12);
-                    } else {
-                        note_freq /= pow(2, 1.0 / 12);
-                    }
-                    notes.erase(0, 1);
-                    continue;
-                }
+    xSemaphoreTake(clips_mutex, portMAX_DELAY);
+    const clip_t &clip = clips[clip_to_play];
+    speakerResampler.setAudioInfo(AudioInfo(clip_rate, 1, 16));
+    speakerResampler.begin();
 
+    size_t pos = 0;
+    while (playing_clip && trigger == clip_trigger && clip.samples != NULL) {
+        if (pos == clip.length) {
+            if (!clip_loop || clip.length == 0) {
                 break;
             }
-            return {(unsigned int)round(note_freq), (unsigned int)(duration_s * 1000)};
+            pos = 0;
+        }
+
+        size_t samples = std::min(clip.length - pos, CLIP_BLOCK_SAMPLES);
+        {
+            YPROFILE_SCOPE(audio_copy);
+            speakerResampler.write((const uint8_t *)(clip.samples + pos),
+                                   samples * sizeof(int16_t));
         }
+        finish_latency_measurement();
+        pos += samples;
+    }
+    xSemaphoreGive(clips_mutex);
+
+    // A clip asked for while this one was playing is played on the next pass
+    if (trigger == clip_trigger) {
+        playing_clip = false;
+    }
+}
+
+// Releases every note and plays until they have died away
+void finish_tones() {
+    synth.release_all();
+    while (synth.is_active()) {
+        play_tone_block(tone_block_samples);
+    }
+}
 
-        // If we reach here then we have a syntax error
-        Serial.printf("Syntax error in notes: %s\n", notes.c_str());
-        notes.clear();
-        break;
+void play_midi_event(const midi_event_t &event) {
+    if (event.channel == MIDI_DRUM_CHANNEL) {
+        return;
     }
 
-    return {0, 0};
+    int key = (event.channel << 8) | event.note;
+    if (event.note_on) {
+        float frequency = 440.0f * powf(2.0f, (event.note - 69) / 12.0f);
+        int voice =
+            synth.note_on(frequency, MIDI_VOICE_AMPLITUDE * event.velocity / 127, MIDI_ENVELOPE);
+        midi_voice_keys[voice] = key;
+    } else {
+        for (int voice = 0; voice < Synth::max_voices; voice++) {
+            if (midi_voice_keys[voice] == key) {
+                synth.note_off(voice);
+                midi_voice_keys[voice] = -1;
+            }
+        }
+    }
 }
 
-void set_wave_volume(uint8_t new_volume) { speakerVolume.setVolume(new_volume / 10.0); }
+size_t read_midi_file(void *context, uint32_t offset, uint8_t *buffer, size_t len) {
+    File *file = (File *)context;
+    if (!file->seek(offset)) {
+        return 0;
+    }
+    return file->read(buffer, len);
+}
+
+void set_wave_volume(uint8_t new_volume) { speakerGain.set_gain(new_volume * Gain::unity / 10); }
 
 void play_speaker_task(void *params) {
     while (1) {
         // Block waiting for something to do
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        speakerWriter.begin();
 
         if (playing_tones) {
-            // Setup sine wave
-            sineWave.begin(sineInfo);
-
-            // Start the audio stream
-            copier.begin(speakerOut, toneStream);
+            synth.silence();
 
             // Play all the notes until there are none left
-            while (notes.length()) {
+            while (playing_tones && (notes_end > notes_start || streaming_notes)) {
                 xSemaphoreTake(notes_mutex, portMAX_DELAY);
                 note_t note = parse_next_note();
                 xSemaphoreGive(notes_mutex);
 
-                // Play the tone and wait for it to finish
-                sineWave.setFrequency(note.frequency);
-                sineWave.setAmplitude(16000 * (volume_notes / 10.0));
+                // Each note is released when its time is up, and its release carries on
+                // under the next note on another voice
+                int voice = -1;
+                if (note.frequency > 0) {
+                    voice = synth.note_on(note.frequency, 1600 * note.volume, note.envelope);
+                }
+                uint32_t samples = (uint64_t)note.duration * speakerInfo.sample_rate / 1000;
+                while (samples > 0 && playing_tones) {
+                    size_t n = std::min((size_t)samples, tone_block_samples);
+                    play_tone_block(n);
+                    samples -= n;
+                }
+                synth.note_off(voice);
+            }
+
+            // Let the last notes die away, even when stopped early
+            finish_tones();
 
-                // Copy during the note duration
-                int start_time = millis();
-                while ((millis() - start_time) < note.duration) {
-                    copier.copy(poppingRemover);
+            // If all of the notes have been played, signal that we are done. Notes added
+            // after a stop are played on the next pass.
+            xSemaphoreTake(notes_mutex, portMAX_DELAY);
+            if (notes_end == notes_start && !streaming_notes) {
+                playing_tones = false;
+            }
+            xSemaphoreGive(notes_mutex);
+        }
+
+        if (playing_midi) {
+            synth.silence();
+            for (int &key : midi_voice_keys) {
+                key = -1;
+            }
+
+            // Render up to each event's time, counted in samples since the song started
+            uint64_t samples_played = 0;
+            midi_event_t event;
+            bool have_event = false;
+            while (playing_midi) {
+                if (!have_event) {
+                    xSemaphoreTake(notes_mutex, portMAX_DELAY);
+                    have_event = midi_reader.next_event(event);
+                    xSemaphoreGive(notes_mutex);
+                    if (!have_event) {
+                        break;
+                    }
+                }
+
+                uint64_t due = event.time_us * speakerInfo.sample_rate / 1000000;
+                if (due > samples_played) {
+                    size_t n = std::min((size_t)(due - samples_played), tone_block_samples);
+                    play_tone_block(n);
+                    samples_played += n;
+                    continue;
                 }
+
+                play_midi_event(event);
+                have_event = false;
             }
 
-            // If all of the notes have been played, signal that we are done
-            playing_tones = false;
+            finish_tones();
+            playing_midi = false;
+        }
+
+        if (playing_clip) {
+            play_clip_samples();
         }
 
         if (playing_file) {
+            // The decoder reports the file's format once it has read the header
+            speakerResampler.begin();
+
             // Keep copying until the file and copier is done
-            while (playing_file &&
-                   !(copier.copy(poppingRemover) == 0 && sound_file.available() == 0))
-                ;
+            while (playing_file) {
+                size_t copied;
+                {
+                    YPROFILE_SCOPE(audio_copy);
+                    copied = copier.copy();
+                }
+
+                if (copied > 0) {
+                    finish_latency_measurement();
+                } else {
+                    if (sound_file.available() == 0) {
+                        break;
+                    }
+
+                    // The file still has data but none of it could be moved on
+                    YPROFILE_COUNT(audio_stalls, 1);
+                }
+            }
             playing_file = false;
         }
     }
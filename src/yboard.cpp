@@ -1,4 +1,9 @@
 #include "yboard.h"
+#include "ygamma.h"
+
+#include <driver/gpio.h>
+#include <esp_heap_caps.h>
+#include <esp_sleep.h>
 
 /////////////////////////////////// Global Yboard object ///////////////////////
 YBoardV4 Yboard;
@@ -14,65 +19,381 @@ void IRAM_ATTR mcp_isr() {
 
 void isr_task(void *pvParameters) {
     while (true) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // More than one pending notification means interrupts arrived while we were busy,
+        // and only the last change on each pin will be seen
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (pending > 1) {
+            YPROFILE_COUNT(dropped_events, pending - 1);
+        }
 
         // Serial.println("ISR fired");
+        Yboard.lock_i2c_bus(i2c_bus::lower);
         Yboard.recache_io_val_on_interrupt();
         Yboard.mcp.clearInterrupts();
+        Yboard.unlock_i2c_bus(i2c_bus::lower);
+    }
+}
+// Queues an item, discarding the oldest queued item if the queue is full. Used for the
+// per-device queues, which are optional feeds alongside the input event queue. Discarded
+// items are counted as dropped events.
+template <typename T> static void queue_send_latest(QueueHandle_t queue, const T &item) {
+    if (xQueueSend(queue, &item, 0) != pdTRUE) {
+        T discarded;
+        if (xQueueReceive(queue, &discarded, 0) == pdTRUE) {
+            YPROFILE_COUNT(dropped_events, 1);
+        }
+        xQueueSend(queue, &item, 0);
     }
 }
+
 /////////////////////////////////// YBoarc Class Methods ///////////////////////
 
 YBoardV4::YBoardV4()
-    : display(128, 64, &upperWire), buttons_cached(0), sw_cached(0), dsw_cached(0),
-      knob_button_cached(false), ir_recv(ir_rx_pin), ir_send(ir_tx_pin),
-      leds(&leds_with_status_led[1]), status_led(&leds_with_status_led[0]) {
-    FastLED.addLeds<APA102, led_data_pin, led_clock_pin, BGR>(leds_with_status_led,
-                                                              num_leds_with_status_led);
+    : display(128, 64, &upperWire, -1, upper_i2c_freq, upper_i2c_freq),
+      leds(&leds_with_status_led[1]), status_led(&leds_with_status_led[0]),
+      ir_recv(ir_rx_pin, ir_rx_buffer_size, ir_rx_timeout_ms, true), ir_send(ir_tx_pin),
+      io_state(0), ir_tx_pending(0) {
+    update_led_correction();
+
+    i2c_buses[static_cast<int>(i2c_bus::upper)] = {&upperWire, NULL, 0, 0,
+                                                   {upper_i2c_freq, 0, 0, 0, 0}};
+    i2c_buses[static_cast<int>(i2c_bus::lower)] = {&lowerWire, NULL, 0, 0,
+                                                   {lower_i2c_freq, 0, 0, 0, 0}};
 }
 
 YBoardV4::~YBoardV4() {}
 
-void YBoardV4::setup() {
-    // Setup interrupt handling task
-    xTaskCreate(isr_task, "isr_task", 4096, NULL, 1, &isr_task_handle);
+// A group of setup stages run one after the other on a helper task
+struct setup_stage_group {
+    YBoardV4 *board;
+    const setup_stage *stages;
+    int num_stages;
+    SemaphoreHandle_t done;
+    TaskHandle_t task;
+};
+
+static const char *const setup_stage_names[] = {
+    "LEDs", "I2C", "IO", "SD Card", "Speaker", "Mic", "Accelerometer", "Display", "IR",
+};
+
+void YBoardV4::setup(const yboard_setup_config &config) {
+    uint32_t setup_start_us = micros();
+    speaker_latency = config.speaker_latency;
+    mic_latency = config.mic_latency;
+    mic_processing = config.mic;
+    YTasks::set_plan(config.tasks);
+
+    // Setup interrupt handling task. This runs above the loop and the bulk transfer tasks,
+    // so IO updates are served ahead of them on the lower I2C bus.
+    YTasks::create(isr_task, "isr_task", 4096, NULL, YTasks::get_plan().isr, &isr_task_handle);
+
+    // The I2C buses must be running before any of the devices on them are probed
+    run_setup_stage(setup_stage::leds);
+    run_setup_stage(setup_stage::i2c);
+
+    // The SD card is the only user of the SPI bus, and the accelerometer and display are
+    // the only users of the upper I2C bus, so these can be probed while the rest of the
+    // board comes up.
+    setup_stage spi_stages[1];
+    int num_spi_stages = 0;
+    if (!config.lazy_sd_card) {
+        spi_stages[num_spi_stages++] = setup_stage::sd_card;
+    }
 
-    setup_leds();
-    setup_i2c();
-    setup_io();
+    setup_stage upper_bus_stages[2];
+    int num_upper_bus_stages = 0;
+    if (!config.lazy_accelerometer) {
+        upper_bus_stages[num_upper_bus_stages++] = setup_stage::accelerometer;
+    }
+    upper_bus_stages[num_upper_bus_stages++] = setup_stage::display;
+
+    setup_stage_group groups[] = {
+        {this, spi_stages, num_spi_stages, NULL, NULL},
+        {this, upper_bus_stages, num_upper_bus_stages, NULL, NULL},
+    };
+
+    StaticSemaphore_t groups_done_buffer;
+    SemaphoreHandle_t groups_done = NULL;
+    int num_groups_started = 0;
+    if (config.parallel) {
+        groups_done = xSemaphoreCreateCountingStatic(2, 0, &groups_done_buffer);
+    }
 
-    if (setup_sd_card()) {
-        Serial.println("SD Card Setup: Success");
+    for (setup_stage_group &group : groups) {
+        if (group.num_stages == 0) {
+            continue;
+        }
+
+        group.done = groups_done;
+        if (groups_done && YTasks::create(setup_stage_task, "setup_stage_task", 4096, &group,
+                                          {tskNO_AFFINITY, 1}, &group.task)) {
+            num_groups_started++;
+        } else {
+            for (int i = 0; i < group.num_stages; i++) {
+                run_setup_stage(group.stages[i]);
+            }
+        }
     }
 
-    if (setup_speaker()) {
-        Serial.println("Speaker Setup: Success");
+    run_setup_stage(setup_stage::io);
+    run_setup_stage(setup_stage::speaker);
+    run_setup_stage(setup_stage::mic);
+    run_setup_stage(setup_stage::ir);
+
+    // Wait for the helper tasks to finish, then stop them so their slots can be used by
+    // tasks created later
+    for (int i = 0; i < num_groups_started; i++) {
+        xSemaphoreTake(groups_done, portMAX_DELAY);
+    }
+    for (setup_stage_group &group : groups) {
+        if (group.task) {
+            YTasks::stop(group.task);
+        }
+    }
+    if (groups_done) {
+        vSemaphoreDelete(groups_done);
     }
 
-    if (setup_mic()) {
-        Serial.println("Mic Setup: Success");
+    setup_total_us = micros() - setup_start_us;
+
+    // Everything the library needs is allocated by now, so this is the steady state
+    print_memory_report();
+}
+
+void YBoardV4::print_profile_report() { YProfile::print_report(Serial); }
+
+void YBoardV4::print_task_report() { YTasks::print_report(Serial); }
+
+void YBoardV4::setup_stage_task(void *params) {
+    setup_stage_group *group = static_cast<setup_stage_group *>(params);
+
+    for (int i = 0; i < group->num_stages; i++) {
+        group->board->run_setup_stage(group->stages[i]);
     }
 
-    if (setup_accelerometer()) {
-        Serial.println("Accelerometer Setup: Success");
+    // Wait to be stopped by setup()
+    xSemaphoreGive(group->done);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
+}
 
-    if (setup_display()) {
-        Serial.println("Display Setup: Success");
+bool YBoardV4::run_setup_stage(setup_stage stage) {
+    uint32_t start_us = micros();
+    bool success = true;
+
+    switch (stage) {
+    case setup_stage::leds:
+        setup_leds();
+        break;
+    case setup_stage::i2c:
+        setup_i2c();
+        break;
+    case setup_stage::io:
+        setup_io();
+        break;
+    case setup_stage::sd_card:
+        success = setup_sd_card();
+        break;
+    case setup_stage::speaker:
+        success = setup_speaker();
+        break;
+    case setup_stage::mic:
+        success = setup_mic();
+        break;
+    case setup_stage::accelerometer:
+        success = setup_accelerometer();
+        break;
+    case setup_stage::display:
+        success = setup_display();
+        break;
+    case setup_stage::ir:
+        success = setup_ir();
+        break;
+    case setup_stage::count:
+        return false;
     }
 
-    setup_ir();
+    // count returned above, but GCC can't see that and warns about the index
+    if (stage < setup_stage::count) {
+        setup_stage_us[static_cast<int>(stage)] = micros() - start_us;
+    }
+
+    switch (stage) {
+    case setup_stage::sd_card:
+    case setup_stage::speaker:
+    case setup_stage::mic:
+    case setup_stage::accelerometer:
+    case setup_stage::display:
+        if (success) {
+            Serial.printf("%s Setup: Success\n", setup_stage_names[static_cast<int>(stage)]);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return success;
+}
+
+uint32_t YBoardV4::get_setup_stage_time(setup_stage stage) {
+    if (stage >= setup_stage::count) {
+        return 0;
+    }
+    return setup_stage_us[static_cast<int>(stage)];
+}
+
+void YBoardV4::print_setup_report() {
+    Serial.println("Setup stage times:");
+    for (int i = 0; i < static_cast<int>(setup_stage::count); i++) {
+        Serial.printf("  %-14s %8lu us\n", setup_stage_names[i], (unsigned long)setup_stage_us[i]);
+    }
+    Serial.printf("  %-14s %8lu us\n", "Total", (unsigned long)setup_total_us);
+}
+
+void YBoardV4::print_memory_report() {
+    Serial.println("Heap memory:");
+    Serial.printf("  %-9s %8lu free %8lu largest block %8lu lowest free\n", "Internal",
+                  (unsigned long)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                  (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+                  (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+
+    size_t psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    if (psram_free > 0) {
+        Serial.printf("  %-9s %8lu free %8lu largest block %8lu lowest free\n", "PSRAM",
+                      (unsigned long)psram_free,
+                      (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+                      (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    }
+}
+
+bool YBoardV4::ensure_sd_card() {
+    if (!sd_card_probed) {
+        run_setup_stage(setup_stage::sd_card);
+    }
+    return sd_card_present;
+}
+
+bool YBoardV4::ensure_accelerometer() {
+    if (!accelerometer_probed) {
+        run_setup_stage(setup_stage::accelerometer);
+    }
+    return accelerometer_present;
 }
 
 void YBoardV4::setup_i2c() {
-    lowerWire.begin(this->lower_i2c_data, this->lower_i2c_clk, this->lower_i2c_freq);
-    upperWire.begin(this->upper_i2c_data, this->upper_i2c_clk, this->upper_i2c_freq);
+    for (int i = 0; i < 2; i++) {
+        i2c_buses[i].mutex = xSemaphoreCreateRecursiveMutexStatic(&i2c_mutex_buffers[i]);
+    }
+
+    lowerWire.begin(this->lower_i2c_data, this->lower_i2c_clk,
+                    i2c_buses[static_cast<int>(i2c_bus::lower)].stats.frequency);
+    upperWire.begin(this->upper_i2c_data, this->upper_i2c_clk,
+                    i2c_buses[static_cast<int>(i2c_bus::upper)].stats.frequency);
+}
+
+////////////////////////////// I2C Buses ///////////////////////////////
+bool YBoardV4::set_i2c_frequency(i2c_bus bus, uint32_t frequency) {
+    uint32_t max_frequency = (bus == i2c_bus::upper) ? upper_i2c_max_freq : lower_i2c_max_freq;
+    if (frequency < 10000 || frequency > max_frequency) {
+        Serial.printf("ERROR: I2C frequency %lu out of range (10000-%lu)\n",
+                      (unsigned long)frequency, (unsigned long)max_frequency);
+        return false;
+    }
+
+    i2c_bus_state &state = i2c_buses[static_cast<int>(bus)];
+    if (!lock_i2c_bus(bus)) {
+        return false;
+    }
+    state.stats.frequency = frequency;
+    state.wire->setClock(frequency);
+    if (bus == i2c_bus::upper) {
+        display.set_bus_clock(frequency);
+    }
+    unlock_i2c_bus(bus);
+
+    return true;
+}
+
+bool YBoardV4::lock_i2c_bus(i2c_bus bus, uint32_t timeout_ms) {
+    i2c_bus_state &state = i2c_buses[static_cast<int>(bus)];
+    if (state.mutex == NULL) {
+        return false;
+    }
+
+    uint32_t wait_start_us = micros();
+    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+
+    // Try without blocking first, so we know whether another task held the bus
+    bool contended = false;
+    if (xSemaphoreTakeRecursive(state.mutex, 0) != pdTRUE) {
+        contended = true;
+        if (xSemaphoreTakeRecursive(state.mutex, ticks) != pdTRUE) {
+            return false;
+        }
+    }
+
+    // Only the outermost lock counts as a transaction
+    if (state.lock_depth++ == 0) {
+        uint32_t now_us = micros();
+        uint32_t wait_us = now_us - wait_start_us;
+        if (contended) {
+            state.stats.contended++;
+        }
+        if (wait_us > state.stats.max_wait_us) {
+            state.stats.max_wait_us = wait_us;
+        }
+        state.lock_start_us = now_us;
+    }
+
+    return true;
+}
+
+void YBoardV4::unlock_i2c_bus(i2c_bus bus) {
+    i2c_bus_state &state = i2c_buses[static_cast<int>(bus)];
+    if (state.mutex == NULL || state.lock_depth == 0) {
+        return;
+    }
+
+    if (--state.lock_depth == 0) {
+        state.stats.transactions++;
+        state.stats.busy_us += micros() - state.lock_start_us;
+    }
+
+    xSemaphoreGiveRecursive(state.mutex);
+}
+
+i2c_bus_stats YBoardV4::get_i2c_stats(i2c_bus bus) {
+    i2c_bus_state &state = i2c_buses[static_cast<int>(bus)];
+    if (state.mutex == NULL) {
+        return state.stats;
+    }
+
+    // The counters are only updated with the bus mutex held, and the 64-bit busy time
+    // can't be read in one go, so hold it while copying them. Taking the mutex directly
+    // rather than through lock_i2c_bus keeps this out of the counters.
+    xSemaphoreTakeRecursive(state.mutex, portMAX_DELAY);
+    i2c_bus_stats stats = state.stats;
+    xSemaphoreGiveRecursive(state.mutex);
+    return stats;
 }
 
 ////////////////////////////// LEDs ///////////////////////////////
 void YBoardV4::setup_leds() {
-    FastLED.clear();
+    leds_mutex = xSemaphoreCreateMutexStatic(&leds_mutex_buffer);
+
+    // Drive the LEDs from a hardware SPI host with DMA. If that can't be set up, fall back
+    // to FastLED, which bit-bangs these pins.
+    if (!setup_led_spi()) {
+        Serial.println("WARNING: LED SPI setup failed, using FastLED output.");
+        FastLED.addLeds<APA102, led_data_pin, led_clock_pin, BGR>(leds_output,
+                                                                  num_leds_with_status_led);
+    }
+    leds_setup = true;
+
     set_led_brightness(120);
+
+    YAnimation::setup(leds, num_leds, leds_mutex, commit_animation_frame, this);
 }
 
 void YBoardV4::set_led_color(uint16_t index, uint8_t red, uint8_t green, uint8_t blue) {
@@ -80,37 +401,219 @@ void YBoardV4::set_led_color(uint16_t index, uint8_t red, uint8_t green, uint8_t
         Serial.printf("ERROR: LED index %d out of range (1-%d)\n", index, num_leds);
         return;
     }
+    lock_leds();
     leds[index - 1] = CRGB(red, green, blue);
-    FastLED.show();
+    unlock_leds();
+    show_leds();
 }
 
 void YBoardV4::set_status_led_color(uint8_t red, uint8_t green, uint8_t blue) {
+    lock_leds();
     *status_led = CRGB(red, green, blue);
-    FastLED.show();
+    unlock_leds();
+    show_leds();
 }
 
 void YBoardV4::set_led_brightness(uint8_t brightness) {
-    if (brightness > 220) {
-        brightness = 220;
+    if (brightness > YLeds::max_brightness) {
+        brightness = YLeds::max_brightness;
     }
-    int max_brightness = 220;                           // Maximum brightness
-    int total_steps = 220;                              // Number of fade steps
-    float gamma = 2.2;                                  // Gamma value for correction
-    float normalized = (float)brightness / total_steps; // Normalize step to [0, 1]
-    int adjusted_brightness = max_brightness * pow(normalized, gamma);
 
-    // Apply the brightness to all LEDs
-    FastLED.setBrightness(adjusted_brightness);
-    FastLED.show();
+    // Apply the brightness to all LEDs, mapped onto a perceptual curve
+    led_brightness = YLeds::brightness_table[brightness];
+    show_leds();
+}
+
+void YBoardV4::set_led_power_budget(uint32_t milliamps) {
+    led_power_budget_ma = milliamps;
+    show_leds();
+}
+
+uint32_t YBoardV4::get_led_current() { return led_current_ma; }
+
+void YBoardV4::set_led_gamma_correction(bool enabled) {
+    led_gamma_enabled = enabled;
+    update_led_correction();
+    show_leds();
+}
+
+void YBoardV4::set_led_white_balance(uint8_t red, uint8_t green, uint8_t blue) {
+    led_white_balance[0] = red;
+    led_white_balance[1] = green;
+    led_white_balance[2] = blue;
+    update_led_correction();
+    show_leds();
+}
+
+void YBoardV4::update_led_correction() {
+    for (int channel = 0; channel < 3; channel++) {
+        for (int level = 0; level < 256; level++) {
+            uint8_t corrected = led_gamma_enabled ? YLeds::gamma_table[level] : level;
+            led_correction[channel][level] = scale8(corrected, led_white_balance[channel]);
+        }
+    }
 }
 
 void YBoardV4::set_all_leds_color(uint8_t red, uint8_t green, uint8_t blue) {
+    lock_leds();
     fill_solid(leds, num_leds, CRGB(red, green, blue));
-    FastLED.show();
+    unlock_leds();
+    show_leds();
+}
+
+// The LED buffer is written by the animation task as well, so writes to it and frames
+// sent from it are made with leds_mutex held. Before the LEDs are set up there is no
+// mutex, and nothing else touches the buffer.
+void YBoardV4::lock_leds() {
+    if (leds_mutex) {
+        xSemaphoreTake(leds_mutex, portMAX_DELAY);
+    }
+}
+
+void YBoardV4::unlock_leds() {
+    if (leds_mutex) {
+        xSemaphoreGive(leds_mutex);
+    }
+}
+
+void YBoardV4::show_leds() {
+    YPROFILE_SCOPE(led_show);
+
+    lock_leds();
+
+    // Apply gamma and white balance into the buffer that is sent to the LEDs
+    for (int i = 0; i < num_leds_with_status_led; i++) {
+        const CRGB &in = leds_with_status_led[i];
+        leds_output[i] = CRGB(led_correction[0][in.r], led_correction[1][in.g],
+                              led_correction[2][in.b]);
+    }
+    if (leds_asleep) {
+        fill_solid(leds_output, num_leds_with_status_led, CRGB::Black);
+    }
+
+    // Estimate the current the frame will draw at full scale, in units of mA * 255 * 255
+    uint32_t channel_load = 0;
+    for (int i = 0; i < num_leds_with_status_led; i++) {
+        const CRGB &out = leds_output[i];
+        channel_load += out.r * led_red_ma + out.g * led_green_ma + out.b * led_blue_ma;
+    }
+    uint32_t full_scale_load = channel_load * 255;
+    uint32_t idle_ma = num_leds_with_status_led * led_idle_ma;
+
+    // Scale the whole frame down if it would go over the budget. The LEDs draw their idle
+    // current even when dark, so a budget at or below that leaves nothing to light them.
+    uint8_t brightness = led_brightness;
+    if (led_power_budget_ma > 0 && full_scale_load > 0) {
+        if (led_power_budget_ma <= idle_ma) {
+            brightness = 0;
+        } else {
+            uint64_t budget_load = (uint64_t)(led_power_budget_ma - idle_ma) * 255 * 255;
+            if ((uint64_t)full_scale_load * brightness > budget_load * 255) {
+                brightness = (budget_load * 255) / full_scale_load;
+            }
+        }
+    }
+    led_current_ma = idle_ma + ((uint64_t)full_scale_load * brightness) / (255 * 255 * 255);
+
+    if (led_spi) {
+        send_led_spi_frame(brightness);
+    } else if (leds_setup) {
+        FastLED.show(brightness);
+    }
+    unlock_leds();
+}
+
+bool YBoardV4::setup_led_spi() {
+    spi_bus_config_t bus_config = {};
+    bus_config.mosi_io_num = led_data_pin;
+    bus_config.miso_io_num = -1;
+    bus_config.sclk_io_num = led_clock_pin;
+    bus_config.quadwp_io_num = -1;
+    bus_config.quadhd_io_num = -1;
+    bus_config.max_transfer_sz = led_spi_frame_size;
+
+    esp_err_t err = spi_bus_initialize(led_spi_host, &bus_config, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK) {
+        Serial.printf("ERROR: LED SPI bus init failed: %s\n", esp_err_to_name(err));
+        return false;
+    }
+
+    spi_device_interface_config_t device_config = {};
+    device_config.mode = 0;
+    device_config.clock_speed_hz = led_spi_clock_hz;
+    device_config.spics_io_num = -1;
+    device_config.queue_size = 2;
+
+    err = spi_bus_add_device(led_spi_host, &device_config, &led_spi);
+    if (err != ESP_OK) {
+        Serial.printf("ERROR: LED SPI device init failed: %s\n", esp_err_to_name(err));
+        led_spi = NULL;
+        return false;
+    }
+
+    // The start frame (four zero bytes) and end frame never change
+    for (uint8_t *buffer : led_spi_buffers) {
+        memset(buffer, 0, led_spi_frame_size);
+    }
+
+    return true;
+}
+
+void YBoardV4::send_led_spi_frame(uint8_t brightness) {
+    // Wait for the previous frame before reusing its transaction. Frames take well under
+    // a millisecond to send, so this rarely waits.
+    wait_led_spi_frame();
+
+    // Encode into the buffer that isn't being sent. Each LED is a header byte with the
+    // 5-bit global brightness at full, then blue, green and red.
+    uint8_t *buffer = led_spi_buffers[led_spi_next];
+    uint8_t *pixel = buffer + 4;
+    for (int i = 0; i < num_leds_with_status_led; i++) {
+        const CRGB &out = leds_output[i];
+        pixel[0] = 0xFF;
+        pixel[1] = scale8(out.b, brightness);
+        pixel[2] = scale8(out.g, brightness);
+        pixel[3] = scale8(out.r, brightness);
+        pixel += 4;
+    }
+
+    led_spi_transaction = {};
+    led_spi_transaction.length = led_spi_frame_size * 8;
+    led_spi_transaction.tx_buffer = buffer;
+
+    if (spi_device_queue_trans(led_spi, &led_spi_transaction, portMAX_DELAY) == ESP_OK) {
+        led_spi_in_flight = true;
+        led_spi_next ^= 1;
+    }
+}
+
+void YBoardV4::wait_led_spi_frame() {
+    if (led_spi_in_flight) {
+        spi_transaction_t *done;
+        spi_device_get_trans_result(led_spi, &done, portMAX_DELAY);
+        led_spi_in_flight = false;
+    }
+}
+
+void YBoardV4::commit_animation_frame(void *arg) { static_cast<YBoardV4 *>(arg)->show_leds(); }
+
+int YBoardV4::start_led_animation(const led_animation &animation) {
+    return YAnimation::start(animation);
+}
+
+void YBoardV4::stop_led_animation(int handle) { YAnimation::stop(handle); }
+
+void YBoardV4::stop_all_led_animations() { YAnimation::stop_all(); }
+
+bool YBoardV4::is_led_animation_running(int handle) { return YAnimation::is_running(handle); }
+
+void YBoardV4::set_led_frame_rate(uint8_t frames_per_second) {
+    YAnimation::set_frame_rate(frames_per_second);
 }
 
 ////////////////////////////////// IO //////////////////////////////////
 void YBoardV4::setup_io() {
+    lock_i2c_bus(i2c_bus::lower);
     mcp.begin_I2C(gpio_addr, &lowerWire);
 
     // Setup pins for buttons/switches/dip switches
@@ -165,11 +668,22 @@ void YBoardV4::setup_io() {
 
     // Recache all IO values
     recache_all_io_vals();
+    unlock_i2c_bus(i2c_bus::lower);
+
+    // Create the input event queue now that the initial state is known, so it only
+    // receives changes
+    input_queue = xQueueCreateStatic(input_queue_length, sizeof(input_event), input_queue_storage,
+                                     &input_queue_buffer);
 
     // Set up pins for rotary encoder
     ESP32Encoder::useInternalWeakPullResistors = puType::none;
     encoder.attachHalfQuad(rot_enc_b, rot_enc_a);
     encoder.clearCount();
+
+    // Start the knob service
+    knob_queue = xQueueCreateStatic(knob_queue_length, sizeof(knob_event), knob_queue_storage,
+                                    &knob_queue_buffer);
+    YTasks::create(knob_task, "knob_task", 4096, this, YTasks::get_plan().knob);
 }
 
 ////////////////////////////// Switches/Buttons ///////////////////////////////
@@ -178,79 +692,217 @@ bool YBoardV4::get_switch(uint8_t switch_idx) {
         return false;
     }
 
-    return sw_cached & (1 << (switch_idx - 1));
+    return get_switches() & (1 << (switch_idx - 1));
 }
 
-uint8_t YBoardV4::get_switches() { return sw_cached; }
+uint8_t YBoardV4::get_switches() { return io_state >> io_switches_shift; }
 
 bool YBoardV4::get_button(uint8_t button_idx) {
     if (button_idx < 1 || button_idx > num_buttons) {
         return false;
     }
-    return buttons_cached & (1 << (button_idx - 1));
+    return get_buttons() & (1 << (button_idx - 1));
 }
 
-uint8_t YBoardV4::get_buttons() { return buttons_cached; }
+uint8_t YBoardV4::get_buttons() { return io_state >> io_buttons_shift; }
 
 int64_t YBoardV4::get_knob() { return encoder.getCount(); }
 
-void YBoardV4::reset_knob() { encoder.clearCount(); }
+void YBoardV4::reset_knob() { set_knob(0); }
+
+void YBoardV4::set_knob(int64_t value) {
+    portENTER_CRITICAL(&knob_lock);
+    encoder.setCount(value);
+    knob_last_count = value;
+    knob_accelerated = value;
+    portEXIT_CRITICAL(&knob_lock);
+}
+
+int32_t YBoardV4::get_knob_velocity() { return knob_velocity; }
+
+int64_t YBoardV4::get_knob_accelerated() {
+    portENTER_CRITICAL(&knob_lock);
+    int64_t value = knob_accelerated;
+    portEXIT_CRITICAL(&knob_lock);
+    return value;
+}
 
-void YBoardV4::set_knob(int64_t value) { encoder.setCount(value); }
+void YBoardV4::set_knob_acceleration(uint8_t max_multiplier) {
+    knob_max_multiplier = max_multiplier < 1 ? 1 : max_multiplier;
+}
+
+bool YBoardV4::get_knob_event(knob_event &event, uint32_t timeout_ms) {
+    if (knob_queue == NULL) {
+        return false;
+    }
+
+    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xQueueReceive(knob_queue, &event, ticks) == pdTRUE;
+}
+
+void YBoardV4::knob_task(void *params) {
+    YBoardV4 *board = static_cast<YBoardV4 *>(params);
+    TickType_t last_wake = xTaskGetTickCount();
+
+    // The average is kept with 8 fractional bits, so it decays all the way to 0 instead
+    // of stopping a few counts short when integer division truncates the last steps
+    int32_t velocity_q8 = 0;
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(knob_poll_ms));
+
+        portENTER_CRITICAL(&board->knob_lock);
+        int64_t count = board->encoder.getCount();
+        int32_t delta = count - board->knob_last_count;
+        board->knob_last_count = count;
+        portEXIT_CRITICAL(&board->knob_lock);
+
+        // Exponential moving average of the instantaneous speed, in counts per second
+        int32_t instant_velocity_q8 = delta * (1000 / knob_poll_ms) * 256;
+        velocity_q8 += (instant_velocity_q8 - velocity_q8) / knob_velocity_smoothing;
+        int32_t velocity =
+            velocity_q8 < 0 ? -((128 - velocity_q8) / 256) : (velocity_q8 + 128) / 256;
+        board->knob_velocity = velocity;
+
+        if (delta == 0) {
+            continue;
+        }
+
+        // Scale the step linearly with speed between the slow and fast thresholds
+        int32_t speed = velocity < 0 ? -velocity : velocity;
+        int32_t multiplier = 1;
+        if (speed >= knob_fast_cps) {
+            multiplier = board->knob_max_multiplier;
+        } else if (speed > knob_slow_cps) {
+            multiplier = 1 + ((board->knob_max_multiplier - 1) * (speed - knob_slow_cps)) /
+                                 (knob_fast_cps - knob_slow_cps);
+        }
+
+        knob_event event;
+        event.delta = delta;
+        event.accelerated_delta = delta * multiplier;
+        event.velocity = velocity;
+        event.timestamp_ms = millis();
+
+        portENTER_CRITICAL(&board->knob_lock);
+        board->knob_accelerated += event.accelerated_delta;
+        portEXIT_CRITICAL(&board->knob_lock);
+
+        queue_send_latest(board->knob_queue, event);
+        board->publish_input_event(input_knob, 0, delta);
+    }
+}
 
-bool YBoardV4::get_knob_button() { return knob_button_cached; }
+bool YBoardV4::get_knob_button() { return (io_state >> io_knob_button_shift) & 1; }
 
 bool YBoardV4::get_dip_switch(uint8_t dip_switch_idx) {
-    if (dip_switch_idx < 1 || dip_switch_idx > 6) {
+    if (dip_switch_idx < 1 || dip_switch_idx > num_dip_switches) {
         return false;
     }
-    return dsw_cached & (1 << (dip_switch_idx - 1));
+    return get_dip_switches() & (1 << (dip_switch_idx - 1));
 }
 
-uint8_t YBoardV4::get_dip_switches() { return dsw_cached; }
+uint8_t YBoardV4::get_dip_switches() { return io_state >> io_dip_switches_shift; }
+
+io_snapshot YBoardV4::get_io_snapshot() { return unpack_io_state(io_state); }
+
+io_snapshot YBoardV4::unpack_io_state(uint32_t state) {
+    io_snapshot snapshot;
+    snapshot.buttons = state >> io_buttons_shift;
+    snapshot.switches = state >> io_switches_shift;
+    snapshot.dip_switches = state >> io_dip_switches_shift;
+    snapshot.knob_button = (state >> io_knob_button_shift) & 1;
+    return snapshot;
+}
 
 void YBoardV4::recache_all_io_vals() {
-    buttons_cached = 0;
-    for (int i = 0; i < 5; i++) {
-        buttons_cached |= (!mcp.digitalRead(gpio_but1 + i)) << i;
-    }
+    YPROFILE_SCOPE(mcp_read);
+
+    // Read both ports in one transfer; bit n is MCP pin n. The bus stays locked until the
+    // changes are published, so a reader with an older value can't overwrite a newer state
+    // or publish its changes out of order.
+    lock_i2c_bus(i2c_bus::lower);
+    uint16_t gpio = mcp.readGPIOAB();
+
+    // Buttons, DIP switches and the knob button are active low, switches are active high
+    uint32_t active_low = ~(uint32_t)gpio;
+    uint32_t buttons = (active_low >> gpio_but1) & ((1 << num_buttons) - 1);
+    uint32_t switches = (gpio >> gpio_sw1) & ((1 << num_switches) - 1);
+    uint32_t dip_switches = (active_low >> gpio_dsw1) & ((1 << num_dip_switches) - 1);
+    uint32_t knob_button = (active_low >> gpio_knob_but6) & 1;
+
+    uint32_t new_state = (buttons << io_buttons_shift) | (switches << io_switches_shift) |
+                         (dip_switches << io_dip_switches_shift) |
+                         (knob_button << io_knob_button_shift);
+    uint32_t old_state = io_state.exchange(new_state);
+
+    publish_io_changes(old_state, new_state);
+    unlock_i2c_bus(i2c_bus::lower);
+}
+
+void YBoardV4::recache_io_val_on_interrupt() { recache_all_io_vals(); }
 
-    dsw_cached = 0;
-    for (int i = 0; i < 6; i++) {
-        dsw_cached |= (!mcp.digitalRead(gpio_dsw1 + i)) << i;
+////////////////////////////// Input Events ///////////////////////////////////
+bool YBoardV4::get_input_event(input_event &event, uint32_t timeout_ms) {
+    if (input_queue == NULL) {
+        return false;
     }
 
-    sw_cached = 0;
-    for (int i = 0; i < 4; i++) {
-        sw_cached |= (mcp.digitalRead(gpio_sw1 + i)) << i;
+    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xQueueReceive(input_queue, &event, ticks) == pdTRUE;
+}
+
+void YBoardV4::set_input_event_filter(uint8_t sources) { input_filter = sources; }
+
+void YBoardV4::publish_input_event(input_source source, uint8_t index, int32_t value) {
+    if (input_queue == NULL || !(input_filter & source)) {
+        return;
     }
 
-    knob_button_cached = !mcp.digitalRead(gpio_knob_but6);
+    input_event event = {source, index, value, (uint32_t)millis()};
+    if (xQueueSend(input_queue, &event, 0) != pdTRUE) {
+        YPROFILE_COUNT(dropped_events, 1);
+    }
 }
 
-void YBoardV4::recache_io_val_on_interrupt() {
-    uint8_t interrupt_pin = mcp.getLastInterruptPin();
-    if (interrupt_pin <= gpio_dsw6) {
-        uint8_t dip_switch_idx = interrupt_pin - gpio_dsw1;
-        bool dip_switch_state = !mcp.digitalRead(interrupt_pin);
-        dsw_cached = (dsw_cached & ~(1 << dip_switch_idx)) | (dip_switch_state << dip_switch_idx);
-    } else if (interrupt_pin == gpio_knob_but6) {
-        knob_button_cached = !mcp.digitalRead(gpio_knob_but6);
-    } else if (interrupt_pin <= gpio_but5) {
-        uint8_t button_idx = interrupt_pin - gpio_but1;
-        bool button_state = !mcp.digitalRead(interrupt_pin);
-        buttons_cached = (buttons_cached & ~(1 << button_idx)) | (button_state << button_idx);
-    } else if (interrupt_pin <= gpio_sw4) {
-        uint8_t switch_idx = interrupt_pin - gpio_sw1;
-        bool switch_state = mcp.digitalRead(interrupt_pin);
-        sw_cached = (sw_cached & ~(1 << switch_idx)) | (switch_state << switch_idx);
+void YBoardV4::publish_io_changes(uint32_t old_state, uint32_t new_state) {
+    if (old_state == new_state) {
+        return;
+    }
+
+    io_snapshot before = unpack_io_state(old_state);
+    io_snapshot after = unpack_io_state(new_state);
+
+    uint8_t changed = before.buttons ^ after.buttons;
+    for (int i = 0; i < num_buttons; i++) {
+        if (changed & (1 << i)) {
+            publish_input_event(input_button, i + 1, (after.buttons >> i) & 1);
+        }
+    }
+
+    changed = before.switches ^ after.switches;
+    for (int i = 0; i < num_switches; i++) {
+        if (changed & (1 << i)) {
+            publish_input_event(input_switch, i + 1, (after.switches >> i) & 1);
+        }
+    }
+
+    changed = before.dip_switches ^ after.dip_switches;
+    for (int i = 0; i < num_dip_switches; i++) {
+        if (changed & (1 << i)) {
+            publish_input_event(input_dip_switch, i + 1, (after.dip_switches >> i) & 1);
+        }
+    }
+
+    if (before.knob_button != after.knob_button) {
+        publish_input_event(input_knob_button, 0, after.knob_button);
     }
 }
 
 ////////////////////////////// Speaker/Tones //////////////////////////////////
 bool YBoardV4::setup_speaker() {
     if (!YAudio::setup_speaker(speaker_i2s_ws_pin, speaker_i2s_bclk_pin, speaker_i2s_data_pin,
-                               speaker_i2s_port)) {
+                               speaker_i2s_port, speaker_latency)) {
         Serial.println("ERROR: Speaker setup failed.");
         return false;
     }
@@ -270,19 +922,24 @@ bool YBoardV4::play_sound_file(const std::string &filename) {
     return true;
 }
 
-bool YBoardV4::play_sound_file_background(const std::string &filename) {
-    // Prepend filename with a / if it doesn't have one
-    std::string _filename = filename;
-    if (_filename[0] != '/') {
-        _filename.insert(0, "/");
+// Prepends filename with a / if it doesn't have one
+static std::string sd_path(const std::string &filename) {
+    std::string path = filename;
+    if (path[0] != '/') {
+        path.insert(0, "/");
     }
+    return path;
+}
 
-    if (!sd_card_present) {
+bool YBoardV4::play_sound_file_background(const std::string &filename) {
+    std::string _filename = sd_path(filename);
+
+    if (!ensure_sd_card()) {
         Serial.println("ERROR: SD Card not present.");
         return false;
     }
 
-    if (!SD.exists(_filename.c_str())) {
+    if (!YFiles::exists(_filename.c_str())) {
         Serial.println("File does not exist.");
         return false;
     }
@@ -306,15 +963,74 @@ bool YBoardV4::play_notes(const std::string &notes) {
 
 bool YBoardV4::play_notes_background(const std::string &notes) { return YAudio::add_notes(notes); }
 
+bool YBoardV4::play_notes_file(const std::string &filename) {
+    if (!play_notes_file_background(filename)) {
+        return false;
+    }
+
+    while (is_audio_playing()) {
+        delay(10);
+    }
+
+    return true;
+}
+
+bool YBoardV4::play_notes_file_background(const std::string &filename) {
+    std::string _filename = sd_path(filename);
+
+    if (!ensure_sd_card()) {
+        Serial.println("ERROR: SD Card not present.");
+        return false;
+    }
+
+    if (!YFiles::exists(_filename.c_str())) {
+        Serial.println("File does not exist.");
+        return false;
+    }
+
+    return YAudio::play_notes_file(_filename);
+}
+
+bool YBoardV4::play_midi_file(const std::string &filename) {
+    if (!play_midi_file_background(filename)) {
+        return false;
+    }
+
+    while (is_audio_playing()) {
+        delay(10);
+    }
+
+    return true;
+}
+
+bool YBoardV4::play_midi_file_background(const std::string &filename) {
+    std::string _filename = sd_path(filename);
+
+    if (!ensure_sd_card()) {
+        Serial.println("ERROR: SD Card not present.");
+        return false;
+    }
+
+    if (!YFiles::exists(_filename.c_str())) {
+        Serial.println("File does not exist.");
+        return false;
+    }
+
+    return YAudio::play_midi_file(_filename);
+}
+
 void YBoardV4::stop_audio() { YAudio::stop_speaker(); }
 
 bool YBoardV4::is_audio_playing() { return YAudio::is_playing(); }
 
 I2SStream &YBoardV4::get_speaker_stream() { return YAudio::get_speaker_stream(); }
 
+audio_latency_stats YBoardV4::get_audio_latency() { return YAudio::get_latency_stats(); }
+
 ////////////////////////////// Microphone ////////////////////////////////////////
 bool YBoardV4::setup_mic() {
-    if (!YAudio::setup_mic(mic_i2s_ws_pin, mic_i2s_data_pin, mic_i2s_port)) {
+    if (!YAudio::setup_mic(mic_i2s_ws_pin, mic_i2s_data_pin, mic_i2s_port, mic_latency,
+                           mic_processing)) {
         Serial.println("ERROR: Mic setup failed.");
         return false;
     }
@@ -325,13 +1041,9 @@ bool YBoardV4::setup_mic() {
 }
 
 bool YBoardV4::start_recording(const std::string &filename) {
-    // Prepend filename with a / if it doesn't have one
-    std::string _filename = filename;
-    if (_filename[0] != '/') {
-        _filename.insert(0, "/");
-    }
+    std::string _filename = sd_path(filename);
 
-    if (!sd_card_present) {
+    if (!ensure_sd_card()) {
         Serial.println("ERROR: SD Card not present.");
         return false;
     }
@@ -343,13 +1055,44 @@ void YBoardV4::stop_recording() { YAudio::stop_recording(); }
 
 bool YBoardV4::is_recording() { return YAudio::is_recording(); }
 
+int YBoardV4::start_clip_recording(uint32_t max_duration_ms) {
+    return YAudio::start_clip_recording(max_duration_ms);
+}
+
+bool YBoardV4::play_clip(int clip, int semitones) {
+    if (!play_clip_background(clip, false, semitones)) {
+        return false;
+    }
+
+    while (is_audio_playing()) {
+        delay(10);
+    }
+
+    return true;
+}
+
+bool YBoardV4::play_clip_background(int clip, bool loop, int semitones) {
+    return YAudio::play_clip(clip, loop, semitones);
+}
+
+uint32_t YBoardV4::get_clip_duration(int clip) { return YAudio::get_clip_duration_ms(clip); }
+
+void YBoardV4::delete_clip(int clip) { YAudio::delete_clip(clip); }
+
 void YBoardV4::set_recording_volume(uint8_t volume) { YAudio::set_recording_gain(volume); }
 
 I2SStream &YBoardV4::get_microphone_stream() { return YAudio::get_mic_stream(); }
 
+AudioStream &YBoardV4::get_processed_mic_stream() { return YAudio::get_processed_mic_stream(); }
+
 ////////////////////////////// Accelerometer /////////////////////////////////////
 bool YBoardV4::setup_accelerometer() {
-    if (!accel.begin(accel_addr, upperWire)) {
+    lock_i2c_bus(i2c_bus::upper);
+    accelerometer_present = accel.begin(accel_addr, upperWire);
+    accelerometer_probed = true;
+    unlock_i2c_bus(i2c_bus::upper);
+
+    if (!accelerometer_present) {
         Serial.println("WARNING: Accelerometer not detected.");
         return false;
     }
@@ -357,13 +1100,29 @@ bool YBoardV4::setup_accelerometer() {
     return true;
 }
 
-bool YBoardV4::accelerometer_available() { return accel.available(); }
+bool YBoardV4::accelerometer_available() {
+    if (!ensure_accelerometer()) {
+        return false;
+    }
+
+    lock_i2c_bus(i2c_bus::upper);
+    bool available = accel.available();
+    unlock_i2c_bus(i2c_bus::upper);
+    return available;
+}
 
 accelerometer_data YBoardV4::get_accelerometer() {
-    accelerometer_data data;
+    accelerometer_data data = {0, 0, 0};
+    if (!ensure_accelerometer()) {
+        return data;
+    }
+
+    YPROFILE_SCOPE(accel_read);
+    lock_i2c_bus(i2c_bus::upper);
     data.x = accel.getX();
     data.y = accel.getY();
     data.z = accel.getZ();
+    unlock_i2c_bus(i2c_bus::upper);
     return data;
 }
 
@@ -376,46 +1135,159 @@ bool YBoardV4::setup_sd_card() {
     SPI.begin(spi_sck_pin, spi_miso_pin, spi_mosi_pin);
 
     // Start microSD Card
-    if (!SD.begin(sd_cs_pin)) {
+    sd_card_probed = true;
+    if (!SD.begin(sd_cs_pin, SPI, 4000000, "/sd", sd_max_open_files)) {
         Serial.println("Error accessing microSD card!");
         sd_card_present = false;
         return false;
     }
 
     sd_card_present = true;
+    YFiles::setup(SD);
 
     return true;
 }
 
+bool YBoardV4::file_exists(const std::string &filename) {
+    if (!ensure_sd_card()) {
+        return false;
+    }
+    return YFiles::exists(sd_path(filename).c_str());
+}
+
+size_t YBoardV4::get_file_size(const std::string &filename) {
+    size_t size = 0;
+    if (!ensure_sd_card() || !YFiles::get_size(sd_path(filename).c_str(), size)) {
+        return 0;
+    }
+    return size;
+}
+
+void YBoardV4::rebuild_file_index() {
+    if (!ensure_sd_card()) {
+        return;
+    }
+    YFiles::rebuild_index();
+}
+
 bool YBoardV4::setup_display() {
-    if (!display.begin(SSD1306_SWITCHCAPVCC, display_addr)) {
+    lock_i2c_bus(i2c_bus::upper);
+    bool found = display.begin(SSD1306_SWITCHCAPVCC, display_addr);
+    unlock_i2c_bus(i2c_bus::upper);
+
+    if (!found) {
         Serial.println("Error initializing display");
         return false;
     }
+    display_present = true;
 
     display.clearDisplay();
     display.setTextColor(WHITE);
     display.setRotation(2);
     display.setTextWrap(false);
     display.setCursor(0, 0);
-    display.display();
+    update_display();
 
     return true;
 }
 
+void YBoardV4::update_display() {
+    YPROFILE_SCOPE(display_flush);
+    lock_i2c_bus(i2c_bus::upper);
+    display.display();
+    unlock_i2c_bus(i2c_bus::upper);
+}
+
+void YBoardV4::set_display_power(bool on) {
+    if (!display_present) {
+        return;
+    }
+
+    lock_i2c_bus(i2c_bus::upper);
+    display.ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+    unlock_i2c_bus(i2c_bus::upper);
+}
+
 //////////////////////////////////// IR //////////////////////////////////////////
 
 bool YBoardV4::setup_ir() {
+    ir_rx_queue = xQueueCreateStatic(ir_rx_queue_length, sizeof(ir_frame), ir_rx_queue_storage,
+                                     &ir_rx_queue_buffer);
+
+    // The receiver is created with a save buffer, so each decode copies the captured
+    // timings out and capture restarts straight away
     ir_recv.enableIRIn();
     ir_send.begin();
+
+    YTasks::create(ir_rx_task, "ir_rx_task", 4096, this, YTasks::get_plan().ir_rx);
+
+    ir_tx_queue = xQueueCreateStatic(ir_tx_queue_length, sizeof(ir_send_request),
+                                     ir_tx_queue_storage, &ir_tx_queue_buffer);
+    YTasks::create(ir_tx_task, "ir_tx_task", 4096, this, YTasks::get_plan().ir_tx);
     return true;
 }
 
-bool YBoardV4::recv_ir() { return ir_recv.decode(&ir_results); }
+void YBoardV4::ir_rx_task(void *params) {
+    YBoardV4 *board = static_cast<YBoardV4 *>(params);
+    ir_frame frame;
 
-void YBoardV4::clear_ir() { ir_recv.resume(); }
+    while (true) {
+        if (board->ir_recv.decode(&frame.results)) {
+            // rawbuf points into the receiver's save buffer, which the next decode
+            // overwrites, so the frame takes its own copy of the timings
+            uint16_t rawlen = std::min(frame.results.rawlen, ir_frame_max_raw);
+            for (uint16_t i = 0; i < rawlen; i++) {
+                frame.raw[i] = frame.results.rawbuf[i];
+            }
+            frame.results.rawlen = rawlen;
+            frame.results.rawbuf = frame.raw;
+            frame.timestamp_ms = millis();
+            queue_send_latest(board->ir_rx_queue, frame);
+            board->publish_input_event(input_ir, 0, frame.results.value);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(ir_rx_poll_ms));
+    }
+}
 
-bool YBoardV4::send_ir(decode_results &data, uint16_t repeat) {
+bool YBoardV4::recv_ir() {
+    ir_frame frame;
+    if (!get_ir_frame(frame)) {
+        return false;
+    }
+
+    ir_results = frame.results;
+    memcpy(ir_results_raw, frame.raw, frame.results.rawlen * sizeof(uint16_t));
+    ir_results.rawbuf = ir_results_raw;
+    return true;
+}
+
+void YBoardV4::clear_ir() {}
+
+bool YBoardV4::get_ir_frame(ir_frame &frame, uint32_t timeout_ms) {
+    if (ir_rx_queue == NULL) {
+        return false;
+    }
+
+    TickType_t ticks = (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    if (xQueueReceive(ir_rx_queue, &frame, ticks) != pdTRUE) {
+        return false;
+    }
+
+    // The frame was copied out of the queue, so point rawbuf at the copy's timings
+    frame.results.rawbuf = frame.raw;
+    return true;
+}
+
+size_t YBoardV4::get_ir_frames(ir_frame *frames, size_t max_frames) {
+    size_t num_frames = 0;
+    while (num_frames < max_frames && get_ir_frame(frames[num_frames])) {
+        num_frames++;
+    }
+    return num_frames;
+}
+
+bool YBoardV4::check_ir_data(const decode_results &data) {
     if (data.rawlen <= 0) {
         Serial.println("No IR data to send");
         return false;
@@ -431,15 +1303,172 @@ bool YBoardV4::send_ir(decode_results &data, uint16_t repeat) {
         return false;
     }
 
-    return ir_send.send(data.decode_type, data.value, data.bits, repeat);
+    return true;
+}
+
+// A blocking send waits for its own request to be sent and takes that request's result,
+// so sends queued by other tasks neither hold it up nor change what it returns
+struct ir_send_waiter {
+    StaticSemaphore_t done_buffer;
+    SemaphoreHandle_t done;
+    bool success;
+};
+
+static void ir_send_finished(bool success, void *arg) {
+    ir_send_waiter *waiter = static_cast<ir_send_waiter *>(arg);
+    waiter->success = success;
+    xSemaphoreGive(waiter->done);
+}
+
+bool YBoardV4::send_ir(decode_results &data, uint16_t repeat) {
+    ir_send_waiter waiter;
+    waiter.done = xSemaphoreCreateBinaryStatic(&waiter.done_buffer);
+    if (!send_ir_background(data, repeat, ir_send_finished, &waiter)) {
+        return false;
+    }
+
+    xSemaphoreTake(waiter.done, portMAX_DELAY);
+    return waiter.success;
 }
 
 bool YBoardV4::send_ir(uint64_t data, uint16_t nbits, uint16_t repeat) {
+    ir_send_waiter waiter;
+    waiter.done = xSemaphoreCreateBinaryStatic(&waiter.done_buffer);
+    if (!send_ir_background(data, nbits, repeat, ir_send_finished, &waiter)) {
+        return false;
+    }
+
+    xSemaphoreTake(waiter.done, portMAX_DELAY);
+    return waiter.success;
+}
+
+bool YBoardV4::send_ir_background(decode_results &data, uint16_t repeat,
+                                  ir_send_callback callback, void *arg) {
+    if (!check_ir_data(data)) {
+        return false;
+    }
+
+    return queue_ir_send({data.decode_type, data.value, data.bits, repeat, callback, arg});
+}
+
+bool YBoardV4::send_ir_background(uint64_t data, uint16_t nbits, uint16_t repeat,
+                                  ir_send_callback callback, void *arg) {
     if (nbits < 1 || nbits > 64) {
         Serial.printf("ERROR: Invalid number of bits %d. Must be between 1 and 64.\n", nbits);
         return false;
     }
 
-    ir_send.sendNEC(data, nbits, repeat);
+    return queue_ir_send({NEC, data, nbits, repeat, callback, arg});
+}
+
+bool YBoardV4::is_ir_sending() { return ir_tx_pending > 0; }
+
+bool YBoardV4::queue_ir_send(const ir_send_request &request) {
+    if (ir_tx_queue == NULL) {
+        Serial.println("ERROR: IR not set up");
+        return false;
+    }
+
+    ir_tx_pending++;
+    if (xQueueSend(ir_tx_queue, &request, 0) != pdTRUE) {
+        ir_tx_pending--;
+        Serial.println("ERROR: IR send queue full");
+        return false;
+    }
+
     return true;
 }
+
+void YBoardV4::ir_tx_task(void *params) {
+    YBoardV4 *board = static_cast<YBoardV4 *>(params);
+    ir_send_request request;
+
+    while (true) {
+        xQueueReceive(board->ir_tx_queue, &request, portMAX_DELAY);
+
+        bool success =
+            board->ir_send.send(request.type, request.value, request.nbits, request.repeat);
+
+        if (request.callback) {
+            request.callback(success, request.arg);
+        }
+
+        board->ir_tx_pending--;
+    }
+}
+
+////////////////////////////// Power //////////////////////////////////////////
+wake_source YBoardV4::sleep(uint32_t timeout_ms) {
+    // Quiet everything that would be cut off part way through
+    YAudio::stop_speaker();
+    if (YAudio::is_recording()) {
+        YAudio::stop_recording();
+    }
+    while (is_ir_sending()) {
+        delay(1);
+    }
+
+    leds_asleep = true;
+    show_leds();
+    if (led_spi) {
+        lock_leds();
+        wait_led_spi_frame();
+        unlock_leds();
+    }
+    set_display_power(false);
+
+    // The encoder pins wake on a change from their current level. The MCP interrupt and
+    // IR receiver outputs are both active low.
+    int enc_a_level = digitalRead(rot_enc_a);
+    int enc_b_level = digitalRead(rot_enc_b);
+    gpio_wakeup_enable((gpio_num_t)rot_enc_a,
+                       enc_a_level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)rot_enc_b,
+                       enc_b_level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)ir_rx_pin, GPIO_INTR_LOW_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)mcp_int_pin, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    if (timeout_ms > 0) {
+        esp_sleep_enable_timer_wakeup((uint64_t)timeout_ms * 1000);
+    }
+
+    // Don't sleep if an input changed while getting ready, as the level wake up would
+    // fire straight away and the MCP interrupt would keep retriggering
+    wake_source source = wake_source::io;
+    if (digitalRead(mcp_int_pin) == HIGH) {
+        esp_light_sleep_start();
+
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+            source = wake_source::timer;
+        } else if (digitalRead(mcp_int_pin) == LOW) {
+            source = wake_source::io;
+        } else if (digitalRead(rot_enc_a) != enc_a_level ||
+                   digitalRead(rot_enc_b) != enc_b_level) {
+            source = wake_source::knob;
+        } else if (digitalRead(ir_rx_pin) == LOW) {
+            source = wake_source::ir;
+        } else {
+            source = wake_source::other;
+        }
+    }
+
+    // Enabling a wake up replaces the pin's interrupt type, so put back the edge
+    // interrupts used by the MCP ISR and the IR receiver
+    gpio_wakeup_disable((gpio_num_t)mcp_int_pin);
+    gpio_wakeup_disable((gpio_num_t)ir_rx_pin);
+    gpio_wakeup_disable((gpio_num_t)rot_enc_a);
+    gpio_wakeup_disable((gpio_num_t)rot_enc_b);
+    gpio_set_intr_type((gpio_num_t)mcp_int_pin, GPIO_INTR_NEGEDGE);
+    gpio_set_intr_type((gpio_num_t)ir_rx_pin, GPIO_INTR_ANYEDGE);
+    gpio_set_intr_type((gpio_num_t)rot_enc_a, GPIO_INTR_DISABLE);
+    gpio_set_intr_type((gpio_num_t)rot_enc_b, GPIO_INTR_DISABLE);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+
+    // Bring the outputs back and pick up anything that changed while asleep
+    recache_all_io_vals();
+    set_display_power(true);
+    leds_asleep = false;
+    show_leds();
+
+    return source;
+}
@@ -0,0 +1,337 @@
+#include "yfiles.h"
+#include "yprofile.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <ctype.h>
+#include <vector>
+
+namespace YFiles {
+
+///////////////////////////////// Configuration Constants //////////////////////
+
+// Directory levels to index, counting the root. Every level holds a directory open
+// while it is walked, and the card only allows a few open files at once.
+static const int max_index_depth = 3;
+
+// Upper limit on indexed files and directories, to bound the RAM used on very full cards
+static const size_t max_indexed_files = 2048;
+
+// Room left in the index for new files (such as recordings), so adding them doesn't
+// have to grow it
+static const size_t index_spare_entries = 32;
+
+// Number of open file handles to keep around
+static const int max_cached_files = 3;
+
+// Card being indexed
+static fs::FS *card = NULL;
+static SemaphoreHandle_t files_mutex = NULL;
+static StaticSemaphore_t files_mutex_buffer;
+
+// Files are identified by a hash of their path, so looking one up doesn't need to build
+// or store any strings. The index is kept sorted by hash.
+typedef struct {
+    uint64_t hash;
+    size_t size;
+} index_entry_t;
+
+static std::vector<index_entry_t> file_index;
+
+// Hashes of the directories' paths, kept sorted, so exists() can answer for them too
+static std::vector<uint64_t> directory_index;
+static bool index_complete = false;
+
+// Handles released by their readers, evicted least recently used first. A handle is
+// taken out of the cache while it is being read, so no two readers share one.
+typedef struct {
+    uint64_t hash;
+    File file;
+    uint32_t last_used;
+} cached_file_t;
+
+static cached_file_t cached_files[max_cached_files];
+static uint32_t use_counter = 0;
+
+//////////////////////////// Private Function Prototypes ///////////////////////
+static uint64_t hash_path(const char *path);
+static index_entry_t *find_entry(uint64_t hash);
+static void set_entry(uint64_t hash, size_t size);
+static void index_directory(File &dir, int depth);
+static void build_index();
+static cached_file_t *find_cached(uint64_t hash);
+static void drop_cached(uint64_t hash);
+
+////////////////////////////// Public Functions ///////////////////////////////
+bool setup(fs::FS &fs) {
+    card = &fs;
+    if (files_mutex == NULL) {
+        files_mutex = xSemaphoreCreateMutexStatic(&files_mutex_buffer);
+    }
+
+    return rebuild_index();
+}
+
+bool rebuild_index() {
+    if (files_mutex == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    for (cached_file_t &cached : cached_files) {
+        cached.hash = 0;
+        cached.file = File();
+        cached.last_used = 0;
+    }
+    build_index();
+    bool complete = index_complete;
+    xSemaphoreGive(files_mutex);
+
+    return complete;
+}
+
+bool exists(const char *path) {
+    if (files_mutex == NULL) {
+        return false;
+    }
+
+    uint64_t hash = hash_path(path);
+    bool found = false;
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    if (find_entry(hash) ||
+        std::binary_search(directory_index.begin(), directory_index.end(), hash)) {
+        found = true;
+    } else if (!index_complete) {
+        // The path may be somewhere that wasn't indexed, so ask the card
+        found = card->exists(path);
+    }
+    xSemaphoreGive(files_mutex);
+
+    return found;
+}
+
+bool get_size(const char *path, size_t &size) {
+    if (files_mutex == NULL) {
+        return false;
+    }
+
+    uint64_t hash = hash_path(path);
+    bool found = false;
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    index_entry_t *entry = find_entry(hash);
+    if (entry) {
+        size = entry->size;
+        found = true;
+    } else if (!index_complete) {
+        // The file may be somewhere that wasn't indexed, so ask the card
+        File file = card->open(path);
+        if (file && !file.isDirectory()) {
+            size = file.size();
+            found = true;
+        }
+    }
+    xSemaphoreGive(files_mutex);
+
+    return found;
+}
+
+size_t get_num_files() {
+    if (files_mutex == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    size_t count = file_index.size();
+    xSemaphoreGive(files_mutex);
+    return count;
+}
+
+File open_read(const char *path) {
+    if (files_mutex == NULL) {
+        return File();
+    }
+
+    uint64_t hash = hash_path(path);
+    File file;
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    cached_file_t *cached = find_cached(hash);
+    if (cached) {
+        file = cached->file;
+        file.seek(0);
+        cached->hash = 0;
+        cached->file = File();
+        cached->last_used = 0;
+    } else if (index_complete && find_entry(hash) == NULL) {
+        // Not on the card, so there's no need to ask it
+    } else {
+        {
+            YPROFILE_SCOPE(sd_open);
+            file = card->open(path);
+        }
+
+        if (!file || file.isDirectory()) {
+            file = File();
+        }
+    }
+    xSemaphoreGive(files_mutex);
+
+    return file;
+}
+
+void release(File &file) {
+    if (files_mutex == NULL || !file) {
+        file = File();
+        return;
+    }
+
+    uint64_t hash = hash_path(file.path());
+
+    // Replace the least recently used handle, which closes it
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    cached_file_t *oldest = &cached_files[0];
+    for (cached_file_t &candidate : cached_files) {
+        if (candidate.last_used < oldest->last_used) {
+            oldest = &candidate;
+        }
+    }
+    oldest->hash = hash;
+    oldest->file = file;
+    oldest->last_used = ++use_counter;
+    xSemaphoreGive(files_mutex);
+
+    file = File();
+}
+
+File open_write(const char *path) {
+    if (files_mutex == NULL) {
+        return File();
+    }
+
+    uint64_t hash = hash_path(path);
+    File file;
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    drop_cached(hash);
+    {
+        YPROFILE_SCOPE(sd_open);
+        file = card->open(path, FILE_WRITE);
+    }
+    if (file) {
+        set_entry(hash, 0);
+    }
+    xSemaphoreGive(files_mutex);
+
+    return file;
+}
+
+void update_size(const char *path, size_t size) {
+    if (files_mutex == NULL) {
+        return;
+    }
+
+    uint64_t hash = hash_path(path);
+
+    xSemaphoreTake(files_mutex, portMAX_DELAY);
+    set_entry(hash, size);
+    xSemaphoreGive(files_mutex);
+}
+
+////////////////////////////// Private Functions ///////////////////////////////
+
+// 64-bit FNV-1a hash of the path in lower case, as the card ignores case
+uint64_t hash_path(const char *path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *path; path++) {
+        hash ^= (uint8_t)tolower((unsigned char)*path);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool entry_before(const index_entry_t &entry, uint64_t hash) { return entry.hash < hash; }
+
+index_entry_t *find_entry(uint64_t hash) {
+    auto entry = std::lower_bound(file_index.begin(), file_index.end(), hash, entry_before);
+    if (entry == file_index.end() || entry->hash != hash) {
+        return NULL;
+    }
+    return &*entry;
+}
+
+void set_entry(uint64_t hash, size_t size) {
+    auto entry = std::lower_bound(file_index.begin(), file_index.end(), hash, entry_before);
+    if (entry != file_index.end() && entry->hash == hash) {
+        entry->size = size;
+    } else {
+        file_index.insert(entry, {hash, size});
+    }
+}
+
+void index_directory(File &dir, int depth) {
+    while (true) {
+        File entry = dir.openNextFile();
+        if (!entry) {
+            return;
+        }
+
+        if (file_index.size() + directory_index.size() >= max_indexed_files) {
+            index_complete = false;
+        } else if (entry.isDirectory()) {
+            directory_index.push_back(hash_path(entry.path()));
+            if (depth + 1 < max_index_depth) {
+                index_directory(entry, depth + 1);
+            } else {
+                index_complete = false;
+            }
+        } else {
+            file_index.push_back({hash_path(entry.path()), entry.size()});
+        }
+    }
+}
+
+// Called with files_mutex held
+void build_index() {
+    file_index.clear();
+    directory_index.clear();
+    index_complete = false;
+
+    File root = card->open("/");
+    if (!root || !root.isDirectory()) {
+        Serial.println("ERROR: Unable to read SD card root directory");
+        return;
+    }
+
+    index_complete = true;
+    directory_index.push_back(hash_path("/"));
+    index_directory(root, 0);
+
+    std::sort(file_index.begin(), file_index.end(),
+              [](const index_entry_t &a, const index_entry_t &b) { return a.hash < b.hash; });
+    file_index.reserve(file_index.size() + index_spare_entries);
+    std::sort(directory_index.begin(), directory_index.end());
+}
+
+cached_file_t *find_cached(uint64_t hash) {
+    for (cached_file_t &cached : cached_files) {
+        // A handle closed before it was released can't be reused
+        if (cached.hash == hash && cached.file) {
+            return &cached;
+        }
+    }
+    return NULL;
+}
+
+void drop_cached(uint64_t hash) {
+    for (cached_file_t &cached : cached_files) {
+        if (cached.hash == hash) {
+            cached.hash = 0;
+            cached.file = File();
+            cached.last_used = 0;
+        }
+    }
+}
+
+}; // namespace YFiles
@@ -0,0 +1,193 @@
+#include "yfrontend.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace YAudio {
+
+// The DC blocker's pole is at 1 - 2^-dc_shift, a cutoff of about 27 Hz at 44.1 kHz
+static const int dc_shift = 8;
+
+static const int coefficient_bits = 29;
+
+// The AGC's level falls by 2^-agc_release_shift per block, taking about 0.4 s to fall
+// most of the way at 44.1 kHz, so the gain doesn't pump between words
+static const int agc_release_shift = 9;
+
+// Below this level the AGC holds its gain, rather than turning up background noise
+static const int32_t agc_noise_floor = 64;
+
+static inline int16_t saturate(int32_t sample) {
+    if (sample > 32767) {
+        return 32767;
+    }
+    if (sample < -32768) {
+        return -32768;
+    }
+    return sample;
+}
+
+MicFrontEnd::MicFrontEnd() : max_gain(Gain::unity) {
+    configure(44100, 0, false, 50);
+}
+
+void MicFrontEnd::configure(uint32_t sample_rate, uint16_t high_pass_hz, bool new_agc,
+                            uint8_t agc_target_percent) {
+    if (sample_rate == 0) {
+        sample_rate = 44100;
+    }
+
+    // Second order Butterworth high-pass, from the Audio EQ Cookbook
+    high_pass = high_pass_hz > 0 && high_pass_hz < sample_rate / 2;
+    if (high_pass) {
+        float w0 = 2.0f * (float)M_PI * high_pass_hz / sample_rate;
+        float alpha = sinf(w0) / (2.0f * 0.70710678f);
+        float cos_w0 = cosf(w0);
+        float a0 = 1.0f + alpha;
+        float scale = (float)(1 << coefficient_bits) / a0;
+
+        b0 = lroundf((1.0f + cos_w0) / 2.0f * scale);
+        b1 = -2 * b0;
+        b2 = b0;
+        a1 = lroundf(-2.0f * cos_w0 * scale);
+        a2 = lroundf((1.0f - alpha) * scale);
+    }
+
+    agc = new_agc;
+    if (agc_target_percent < 1 || agc_target_percent > 100) {
+        agc_target_percent = 50;
+    }
+    agc_target = 32767 * agc_target_percent / 100;
+
+    // The AGC changes the gain a little every block, and each change is ramped over the
+    // next block
+    gain.set_ramp(agc ? block_size : sample_rate / 100);
+    gain.set_gain(max_gain);
+
+    reset();
+}
+
+void MicFrontEnd::set_gain(int32_t new_gain) {
+    max_gain = new_gain;
+
+    // The AGC only keeps to the new limit once there is something to hear, so apply it
+    // straight away if it is lower
+    if (!agc || gain.get_gain() > new_gain) {
+        gain.set_gain(new_gain);
+    }
+}
+
+void MicFrontEnd::reset() {
+    dc_last_in = 0;
+    dc_out = 0;
+    x1 = x2 = y1 = y2 = 0;
+    hp_error = 0;
+
+    memset(delay, 0, sizeof(delay));
+    delay_pos = 0;
+    memset(block_peaks, 0, sizeof(block_peaks));
+    block_index = 0;
+    block_fill = 0;
+    block_peak = 0;
+    level = 0;
+}
+
+void MicFrontEnd::process(int16_t *samples, size_t count) {
+    if (!agc) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = filter(samples[i]);
+        }
+        gain.process(samples, count);
+        return;
+    }
+
+    // Work up to each block boundary, so the gain is updated once per block
+    size_t done = 0;
+    while (done < count) {
+        size_t n = count - done;
+        if (n > block_size - block_fill) {
+            n = block_size - block_fill;
+        }
+
+        int16_t *chunk = samples + done;
+        for (size_t i = 0; i < n; i++) {
+            int16_t sample = filter(chunk[i]);
+            int32_t magnitude = sample < 0 ? -sample : sample;
+            if (magnitude > block_peak) {
+                block_peak = magnitude;
+            }
+
+            // Swap the sample for the one from the lookahead's length ago
+            chunk[i] = delay[delay_pos];
+            delay[delay_pos] = sample;
+            delay_pos = (delay_pos + 1) % (block_size * lookahead_blocks);
+        }
+        gain.process(chunk, n);
+
+        done += n;
+        block_fill += n;
+        if (block_fill == block_size) {
+            update_agc();
+        }
+    }
+}
+
+////////////////////////////// Private Functions ///////////////////////////////
+
+int16_t MicFrontEnd::filter(int32_t sample) {
+    // DC blocker: y[n] = x[n] - x[n-1] + (1 - 2^-dc_shift) y[n-1]
+    dc_out += ((sample - dc_last_in) << dc_shift) - (dc_out >> dc_shift);
+    dc_last_in = sample;
+    int32_t out = saturate(dc_out >> dc_shift);
+
+    if (high_pass) {
+        // The bits dropped from each output are added back into the next one. With the
+        // poles this close to 1, simply dropping them would build up into a DC offset.
+        int64_t acc = (int64_t)b0 * out + (int64_t)b1 * x1 + (int64_t)b2 * x2 -
+                      (int64_t)a1 * y1 - (int64_t)a2 * y2 + hp_error;
+        int32_t result = acc >> coefficient_bits;
+        hp_error = acc - ((int64_t)result << coefficient_bits);
+        x2 = x1;
+        x1 = out;
+        out = saturate(result);
+        y2 = y1;
+        y1 = out;
+    }
+
+    return out;
+}
+
+// Called at the end of each block, with the peak of the block that has just gone into
+// the lookahead
+void MicFrontEnd::update_agc() {
+    block_peaks[block_index] = block_peak;
+    block_index = (block_index + 1) % lookahead_blocks;
+    block_fill = 0;
+    block_peak = 0;
+
+    // Keep the gain down while a peak is anywhere in the lookahead
+    int32_t peak = 0;
+    for (int32_t block : block_peaks) {
+        if (block > peak) {
+            peak = block;
+        }
+    }
+
+    level -= level >> agc_release_shift;
+    if ((peak << 8) > level) {
+        level = peak << 8;
+    }
+
+    int32_t current = level >> 8;
+    if (current < agc_noise_floor) {
+        return;
+    }
+
+    int32_t wanted = (agc_target * Gain::unity) / current;
+    if (wanted > max_gain) {
+        wanted = max_gain;
+    }
+    gain.set_gain(wanted);
+}
+
+}; // namespace YAudio
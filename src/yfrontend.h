@@ -0,0 +1,74 @@
+#ifndef YFRONTEND_H
+#define YFRONTEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ygain.h"
+
+// The microphone front end has no Arduino or FreeRTOS dependencies, so it can be
+// compiled and exercised on a host machine.
+
+namespace YAudio {
+
+// Cleans up 16-bit mono audio from the microphone, in place and in fixed point:
+//  - a DC blocker takes out the microphone's offset,
+//  - an optional high-pass filter takes out rumble and handling noise,
+//  - and either a fixed gain or automatic gain control (AGC) sets the level.
+// The AGC looks ahead by delaying the audio a few milliseconds, so it can turn the gain
+// down before a loud sound arrives rather than clipping its start.
+class MicFrontEnd {
+  public:
+    // The AGC measures the level in blocks of this many samples, and looks ahead this
+    // many blocks (about 6 ms at 44.1 kHz)
+    static constexpr size_t block_size = 32;
+    static constexpr size_t lookahead_blocks = 8;
+
+    MicFrontEnd();
+
+    // high_pass_hz of 0 turns the high-pass filter off. agc_target_percent is the peak
+    // level the AGC aims for, as a percentage of full scale.
+    void configure(uint32_t sample_rate, uint16_t high_pass_hz, bool agc,
+                   uint8_t agc_target_percent);
+
+    // Sets the gain (in Q15, see Gain) applied without AGC, or the most the AGC may apply
+    void set_gain(int32_t gain);
+
+    // Clears the filters and the lookahead, for when a new recording starts
+    void reset();
+
+    void process(int16_t *samples, size_t count);
+
+  private:
+    // DC blocker state, with 8 extra fraction bits
+    int32_t dc_last_in;
+    int32_t dc_out;
+
+    // High-pass biquad, with coefficients in Q29
+    bool high_pass;
+    int32_t b0, b1, b2, a1, a2;
+    int32_t x1, x2, y1, y2;
+    int32_t hp_error;
+
+    // AGC state. level is the recent peak level with 8 extra fraction bits, which rises
+    // at once and falls slowly.
+    bool agc;
+    int32_t agc_target;
+    volatile int32_t max_gain;
+    int16_t delay[block_size * lookahead_blocks];
+    size_t delay_pos;
+    int32_t block_peaks[lookahead_blocks];
+    size_t block_index;
+    size_t block_fill;
+    int32_t block_peak;
+    int32_t level;
+
+    Gain gain;
+
+    int16_t filter(int32_t sample);
+    void update_agc();
+};
+
+}; // namespace YAudio
+
+#endif /* YFRONTEND_H */
@@ -0,0 +1,83 @@
+#include "ygain.h"
+
+namespace YAudio {
+
+// Fraction bits used while boosting. With fewer bits the gain can go above unity without
+// the product overflowing 32 bits.
+static const int boost_bits = 11;
+
+static inline int16_t saturate(int32_t sample) {
+    if (sample > 32767) {
+        return 32767;
+    }
+    if (sample < -32768) {
+        return -32768;
+    }
+    return sample;
+}
+
+// Applies a gain that is the same for every sample
+static void apply_constant(int16_t *samples, size_t count, int32_t gain) {
+    if (gain == Gain::unity) {
+        return;
+    }
+
+    if (gain <= Gain::unity) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = (samples[i] * gain) >> 15;
+        }
+    } else {
+        int32_t boost = gain >> (15 - boost_bits);
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = saturate((samples[i] * boost) >> boost_bits);
+        }
+    }
+}
+
+// Ramps take 10 ms at 44.1 kHz unless set otherwise
+Gain::Gain() : requested(unity), target(unity), current(unity), step(0), ramp_left(0) {
+    set_ramp(441);
+}
+
+void Gain::set_ramp(uint32_t samples) { ramp_samples = samples ? samples : 1; }
+
+void Gain::set_gain(int32_t gain) {
+    if (gain < 0) {
+        gain = 0;
+    } else if (gain > max_gain) {
+        gain = max_gain;
+    }
+    requested = gain;
+}
+
+void Gain::process(int16_t *samples, size_t count) {
+    // Start a ramp towards a newly requested gain, from wherever the last one got to
+    int32_t new_target = requested;
+    if (new_target != target) {
+        target = new_target;
+        ramp_left = ramp_samples;
+        step = (target - current) / (int32_t)ramp_samples;
+    }
+
+    size_t done = 0;
+    if (ramp_left > 0) {
+        size_t ramp = count < ramp_left ? count : ramp_left;
+        int32_t gain = current;
+
+        // Above unity the gain loses some fraction bits so the product still fits
+        for (; done < ramp; done++) {
+            gain += step;
+            int32_t scaled = gain <= unity ? (samples[done] * gain) >> 15
+                                           : (samples[done] * (gain >> (15 - boost_bits))) >>
+                                                 boost_bits;
+            samples[done] = saturate(scaled);
+        }
+
+        ramp_left -= ramp;
+        current = ramp_left > 0 ? gain : target;
+    }
+
+    apply_constant(samples + done, count - done, current);
+}
+
+}; // namespace YAudio
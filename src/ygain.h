@@ -0,0 +1,45 @@
+#ifndef YGAIN_H
+#define YGAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The gain stage has no Arduino or FreeRTOS dependencies, so it can be compiled and
+// exercised on a host machine.
+
+namespace YAudio {
+
+// Scales 16-bit samples by a fixed-point gain, clipping rather than wrapping when the
+// result is out of range. A new gain is reached by a linear ramp rather than a jump, so
+// changing the volume doesn't click.
+class Gain {
+  public:
+    // Gains are in Q15: unity is 1 << 15, and gains can go up to 16x
+    static constexpr int32_t unity = 1 << 15;
+    static constexpr int32_t max_gain = 16 * unity;
+
+    Gain();
+
+    // Sets how many samples a change of gain takes
+    void set_ramp(uint32_t samples);
+
+    // Sets the gain to ramp to. This can be called while another task is processing
+    // samples; the ramp starts with the next block.
+    void set_gain(int32_t gain);
+    int32_t get_gain() const { return requested; }
+
+    // Applies the gain to a block of samples in place
+    void process(int16_t *samples, size_t count);
+
+  private:
+    volatile int32_t requested;
+    int32_t target;
+    int32_t current;
+    int32_t step;
+    uint32_t ramp_samples;
+    uint32_t ramp_left;
+};
+
+}; // namespace YAudio
+
+#endif /* YGAIN_H */
@@ -0,0 +1,67 @@
+#ifndef YGAMMA_H
+#define YGAMMA_H
+
+#include <stdint.h>
+
+// The LED curves have no Arduino or FreeRTOS dependencies, so they can be compiled and
+// checked on a host machine.
+
+namespace YLeds {
+
+// Highest brightness the LEDs are driven at, out of 255
+static constexpr int max_brightness = 220;
+
+// The tables are constexpr, so they are built into flash at compile time and can be
+// checked by the compiler. Each file that uses one gets its own copy, and only yboard.cpp
+// uses them on the board.
+
+// Perceptual curve for color values, round(255 * (i / 255)^2.2)
+// clang-format off
+static constexpr uint8_t gamma_table[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6,
+    6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+    12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19,
+    20, 20, 21, 22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28, 29,
+    30, 30, 31, 32, 33, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41,
+    42, 43, 43, 44, 45, 46, 47, 48, 49, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71,
+    73, 74, 75, 76, 77, 78, 79, 81, 82, 83, 84, 85, 87, 88, 89, 90,
+    91, 93, 94, 95, 97, 98, 99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+// clang-format on
+
+// Brightness setting to the brightness sent to the LEDs, (int)(220 * (i / 220)^2.2).
+// This is the curve set_led_brightness has always used, truncated as before.
+// clang-format off
+static constexpr uint8_t brightness_table[max_brightness + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 6, 6, 6, 7, 7,
+    7, 8, 8, 8, 9, 9, 10, 10, 10, 11, 11, 12, 12, 13, 13, 14,
+    14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 20, 20, 21, 21, 22, 23,
+    23, 24, 25, 25, 26, 27, 27, 28, 29, 30, 30, 31, 32, 33, 33, 34,
+    35, 36, 37, 37, 38, 39, 40, 41, 42, 43, 44, 45, 45, 46, 47, 48,
+    49, 50, 51, 52, 53, 54, 55, 56, 57, 59, 60, 61, 62, 63, 64, 65,
+    66, 67, 69, 70, 71, 72, 73, 75, 76, 77, 78, 80, 81, 82, 83, 85,
+    86, 87, 89, 90, 91, 93, 94, 96, 97, 98, 100, 101, 103, 104, 106, 107,
+    109, 110, 112, 113, 115, 116, 118, 119, 121, 123, 124, 126, 128, 129, 131, 132,
+    134, 136, 138, 139, 141, 143, 144, 146, 148, 150, 152, 153, 155, 157, 159, 161,
+    163, 164, 166, 168, 170, 172, 174, 176, 178, 180, 182, 184, 186, 188, 190, 192,
+    194, 196, 198, 200, 202, 204, 207, 209, 211, 213, 215, 217, 220,
+};
+// clang-format on
+
+static_assert(gamma_table[0] == 0 && gamma_table[255] == 255, "gamma curve must keep its ends");
+static_assert(brightness_table[max_brightness] == max_brightness,
+              "full brightness must stay at max_brightness");
+
+}; // namespace YLeds
+
+#endif /* YGAMMA_H */
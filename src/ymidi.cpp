@@ -0,0 +1,254 @@
+#include "ymidi.h"
+
+#include <string.h>
+
+namespace YAudio {
+
+// Tempo until the song sets one: 120 beats per minute
+static const uint32_t default_us_per_quarter = 500000;
+
+static uint32_t read_be(const uint8_t *data, int len) {
+    uint32_t value = 0;
+    for (int i = 0; i < len; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+MidiReader::MidiReader() : read(NULL), context(NULL), num_tracks(0), smpte(false) {}
+
+bool MidiReader::begin(read_function new_read, void *new_context) {
+    read = new_read;
+    context = new_context;
+    num_tracks = 0;
+
+    tempo_tick = 0;
+    tempo_us = 0;
+    us_per_quarter = default_us_per_quarter;
+
+    // Header chunk
+    uint8_t header[14];
+    if (read(context, 0, header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, "MThd", 4) != 0) {
+        return false;
+    }
+
+    uint32_t header_len = read_be(header + 4, 4);
+    uint16_t format = read_be(header + 8, 2);
+    uint16_t expected_tracks = read_be(header + 10, 2);
+    uint16_t division = read_be(header + 12, 2);
+
+    // Format 2 files hold separate songs rather than parts of one song
+    if (header_len < 6 || format > 1 || division == 0) {
+        return false;
+    }
+
+    if (division & 0x8000) {
+        // Ticks per SMPTE frame. Treat a "quarter note" as one second, so the tempo never
+        // changes it.
+        uint32_t frames_per_second = -(int8_t)(division >> 8);
+        ticks_per_quarter = frames_per_second * (division & 0xFF);
+        us_per_quarter = 1000000;
+        smpte = true;
+        if (ticks_per_quarter == 0) {
+            return false;
+        }
+    } else {
+        ticks_per_quarter = division;
+        smpte = false;
+    }
+
+    // Find the track chunks, skipping any others. Tracks past max_tracks are left out. In
+    // format 1 files the tempo map is in the first track, so the song keeps its timing.
+    uint32_t offset = 8 + header_len;
+    while (num_tracks < expected_tracks && num_tracks < max_tracks) {
+        uint8_t chunk[8];
+        if (read(context, offset, chunk, sizeof(chunk)) != sizeof(chunk)) {
+            break;
+        }
+        uint32_t chunk_len = read_be(chunk + 4, 4);
+        offset += sizeof(chunk);
+
+        if (memcmp(chunk, "MTrk", 4) == 0) {
+            track_t &track = tracks[num_tracks++];
+            track.end = offset + chunk_len;
+            track.buffer_offset = offset;
+            track.buffer_pos = 0;
+            track.buffer_len = 0;
+            track.running_status = 0;
+            track.next_tick = 0;
+            track.done = !read_delta(track);
+        }
+        offset += chunk_len;
+    }
+
+    return num_tracks > 0;
+}
+
+bool MidiReader::next_event(midi_event_t &event) {
+    while (true) {
+        // Take the earliest event of any track
+        track_t *track = NULL;
+        for (int i = 0; i < num_tracks; i++) {
+            if (!tracks[i].done && (track == NULL || tracks[i].next_tick < track->next_tick)) {
+                track = &tracks[i];
+            }
+        }
+        if (track == NULL) {
+            return false;
+        }
+
+        uint64_t tick = track->next_tick;
+
+        // A data byte where a status byte should be repeats the last status
+        uint8_t status;
+        if (!read_byte(*track, status)) {
+            track->done = true;
+            continue;
+        }
+        uint8_t first_data = 0;
+        bool have_first_data = false;
+        if (status < 0x80) {
+            first_data = status;
+            have_first_data = true;
+            status = track->running_status;
+        } else if (status < 0xF0) {
+            track->running_status = status;
+        } else {
+            track->running_status = 0;
+        }
+
+        bool found = false;
+        bool ok = true;
+
+        if (status == 0xFF) {
+            // Meta event
+            uint8_t type;
+            uint32_t len;
+            ok = read_byte(*track, type) && read_length(*track, len);
+            if (ok && type == 0x51 && len == 3 && !smpte) {
+                // Tempo change, in microseconds per quarter note
+                uint8_t tempo[3];
+                ok = read_byte(*track, tempo[0]) && read_byte(*track, tempo[1]) &&
+                     read_byte(*track, tempo[2]);
+                if (ok) {
+                    tempo_us = tick_to_us(tick);
+                    tempo_tick = tick;
+                    us_per_quarter = read_be(tempo, 3);
+                }
+            } else if (ok && type == 0x2F) {
+                // End of track
+                track->done = true;
+                continue;
+            } else if (ok) {
+                ok = skip(*track, len);
+            }
+        } else if (status == 0xF0 || status == 0xF7) {
+            // System exclusive
+            uint32_t len;
+            ok = read_length(*track, len) && skip(*track, len);
+        } else if (status >= 0x80 && status < 0xF0) {
+            // Channel message, with one or two data bytes
+            uint8_t type = status & 0xF0;
+            int data_len = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+            uint8_t data[2] = {first_data, 0};
+            for (int i = have_first_data ? 1 : 0; ok && i < data_len; i++) {
+                ok = read_byte(*track, data[i]);
+            }
+
+            if (ok && (type == 0x80 || type == 0x90)) {
+                event.time_us = tick_to_us(tick);
+                event.note_on = type == 0x90 && data[1] > 0;
+                event.channel = status & 0x0F;
+                event.note = data[0] & 0x7F;
+                event.velocity = data[1] & 0x7F;
+                found = true;
+            }
+        } else {
+            // Nothing else belongs in a file, so the track is damaged
+            ok = false;
+        }
+
+        if (!ok || !read_delta(*track)) {
+            track->done = true;
+        }
+        if (found) {
+            return true;
+        }
+    }
+}
+
+////////////////////////////// Private Functions ///////////////////////////////
+
+bool MidiReader::read_byte(track_t &track, uint8_t &value) {
+    if (track.buffer_pos == track.buffer_len) {
+        // Read the next part of the track
+        uint32_t offset = track.buffer_offset + track.buffer_len;
+        if (offset >= track.end) {
+            return false;
+        }
+        uint32_t len = track.end - offset;
+        if (len > track_buffer_size) {
+            len = track_buffer_size;
+        }
+
+        size_t got = read(context, offset, track.buffer, len);
+        if (got == 0) {
+            return false;
+        }
+        track.buffer_offset = offset;
+        track.buffer_len = got;
+        track.buffer_pos = 0;
+    }
+
+    value = track.buffer[track.buffer_pos++];
+    return true;
+}
+
+// Reads a variable length quantity: 7 bits per byte, most significant first, with the
+// top bit set on all but the last byte
+bool MidiReader::read_length(track_t &track, uint32_t &value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8_t byte;
+        if (!read_byte(track, byte)) {
+            return false;
+        }
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MidiReader::skip(track_t &track, uint32_t len) {
+    if (len <= (uint32_t)(track.buffer_len - track.buffer_pos)) {
+        track.buffer_pos += len;
+        return true;
+    }
+
+    // Past what has been read, so start reading again from there
+    uint32_t offset = track.buffer_offset + track.buffer_pos + len;
+    track.buffer_offset = offset;
+    track.buffer_pos = 0;
+    track.buffer_len = 0;
+    return offset <= track.end;
+}
+
+bool MidiReader::read_delta(track_t &track) {
+    uint32_t delta;
+    if (!read_length(track, delta)) {
+        return false;
+    }
+    track.next_tick += delta;
+    return true;
+}
+
+// Events are read in time order, so only the time since the last tempo change needs
+// converting at the current tempo
+uint64_t MidiReader::tick_to_us(uint64_t tick) const {
+    return tempo_us + (tick - tempo_tick) * us_per_quarter / ticks_per_quarter;
+}
+
+}; // namespace YAudio
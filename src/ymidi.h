@@ -0,0 +1,79 @@
+#ifndef YMIDI_H
+#define YMIDI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The MIDI reader has no Arduino or FreeRTOS dependencies, so it can be compiled and
+// exercised on a host machine.
+
+namespace YAudio {
+
+typedef struct {
+    uint64_t time_us; // From the start of the song
+    bool note_on;     // Otherwise note off
+    uint8_t channel;
+    uint8_t note;
+    uint8_t velocity;
+} midi_event_t;
+
+// Reads the notes from a Standard MIDI File (format 0 or 1) in the order they are to be
+// played, merging the tracks as it goes. Only a few bytes of each track are held in
+// memory at a time, and tempo changes are applied as they are reached, so songs of any
+// length can be played straight from a file. Only the first max_tracks tracks are played.
+class MidiReader {
+  public:
+    static constexpr int max_tracks = 16;
+
+    // Reads up to len bytes starting at offset into buffer, returning how many were read
+    typedef size_t (*read_function)(void *context, uint32_t offset, uint8_t *buffer,
+                                    size_t len);
+
+    MidiReader();
+
+    // Reads the header and finds the tracks. Returns false if the data isn't a MIDI file
+    // that can be played.
+    bool begin(read_function read, void *context);
+
+    // Gets the next note on or off. Returns false at the end of the song. A damaged track
+    // is played up to the damage.
+    bool next_event(midi_event_t &event);
+
+  private:
+    static constexpr int track_buffer_size = 32;
+
+    typedef struct {
+        uint32_t end;           // Offset just past the end of the track
+        uint32_t buffer_offset; // Offset of buffer[0] in the file
+        uint8_t buffer[track_buffer_size];
+        uint8_t buffer_pos;
+        uint8_t buffer_len;
+        uint8_t running_status;
+        bool done;
+        uint64_t next_tick; // Time of the track's next event
+    } track_t;
+
+    read_function read;
+    void *context;
+    track_t tracks[max_tracks];
+    int num_tracks;
+
+    // Time in ticks and microseconds of the last tempo change, and the tempo since then,
+    // as microseconds per quarter note and ticks per quarter note. Files timed in SMPTE
+    // frames have a fixed tempo.
+    uint64_t tempo_tick;
+    uint64_t tempo_us;
+    uint32_t us_per_quarter;
+    uint32_t ticks_per_quarter;
+    bool smpte;
+
+    bool read_byte(track_t &track, uint8_t &value);
+    bool read_length(track_t &track, uint32_t &value);
+    bool skip(track_t &track, uint32_t len);
+    bool read_delta(track_t &track);
+    uint64_t tick_to_us(uint64_t tick) const;
+};
+
+}; // namespace YAudio
+
+#endif /* YMIDI_H */
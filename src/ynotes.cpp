@@ -0,0 +1,268 @@
+#include "ynotes.h"
+
+#include <ctype.h>
+#include <math.h>
+
+namespace YAudio {
+
+// Ratio between the frequencies of two notes a half-step apart
+static const float half_step = 1.0594630943592953f;
+
+// Longest attack, decay or release accepted by the W command
+static const int max_envelope_ms = 10000;
+
+// Reads an unsigned decimal number starting at text[pos], advancing pos past it.
+// Returns false if there are no digits at pos.
+static bool read_number(const char *text, size_t len, size_t &pos, int &value) {
+    if (pos >= len || !isdigit((unsigned char)text[pos])) {
+        return false;
+    }
+
+    value = 0;
+    while (pos < len && isdigit((unsigned char)text[pos])) {
+        // Clamp rather than overflow; anything this large is out of range anyway
+        if (value < 100000) {
+            value = value * 10 + (text[pos] - '0');
+        }
+        pos++;
+    }
+    return true;
+}
+
+NoteParser::NoteParser() { reset(); }
+
+void NoteParser::reset() {
+    beats_per_minute = 120;
+    octave = 5;
+    volume = 5;
+    envelope = default_envelope;
+}
+
+NoteParser::result NoteParser::parse(const char *text, size_t len, note_t &note,
+                                     size_t &consumed, bool more_text) {
+    size_t pos = 0;
+
+    // Where the current note or command starts, and the state before it, so it can be
+    // put back if it turns out to be cut short
+    size_t token_start = 0;
+    NoteParser before = *this;
+
+    while (pos < len) {
+        char c = text[pos];
+
+        // Skip white space
+        if (isspace((unsigned char)c)) {
+            pos++;
+            continue;
+        }
+
+        token_start = pos;
+        before = *this;
+
+        // Octave
+        if (c == 'O' || c == 'o') {
+            if (pos + 1 < len) {
+                int new_octave = text[pos + 1] - '0';
+                if (new_octave >= 4 && new_octave <= 7) {
+                    octave = new_octave;
+                }
+            }
+            pos += 2;
+            continue;
+        }
+
+        // Tempo
+        if (c == 'T' || c == 't') {
+            pos++;
+            int new_tempo;
+            if (!read_number(text, len, pos, new_tempo)) {
+                break;
+            }
+            if (new_tempo >= 40 && new_tempo <= 240) {
+                beats_per_minute = new_tempo;
+            }
+            continue;
+        }
+
+        // Reset
+        if (c == '!') {
+            reset();
+            pos++;
+            continue;
+        }
+
+        // Volume
+        if (c == 'V' || c == 'v') {
+            pos++;
+            int new_volume;
+            if (!read_number(text, len, pos, new_volume)) {
+                break;
+            }
+            if (new_volume >= 1 && new_volume <= 10) {
+                volume = new_volume;
+            }
+            continue;
+        }
+
+        // Envelope, as attack,decay,sustain,release
+        if (c == 'W' || c == 'w') {
+            pos++;
+            int values[4];
+            int count = 0;
+            while (count < 4 && read_number(text, len, pos, values[count])) {
+                count++;
+                if (count < 4) {
+                    if (pos >= len || text[pos] != ',') {
+                        break;
+                    }
+                    pos++;
+                }
+            }
+            if (count < 4) {
+                break;
+            }
+            if (values[0] <= max_envelope_ms && values[1] <= max_envelope_ms &&
+                values[2] <= 100 && values[3] <= max_envelope_ms) {
+                envelope.attack_ms = values[0];
+                envelope.decay_ms = values[1];
+                envelope.sustain = values[2];
+                envelope.release_ms = values[3];
+            }
+            continue;
+        }
+
+        float duration_s = (60.0f / beats_per_minute); // Quarter note duration in seconds
+        float note_freq;
+
+        // A-G regular notes
+        // R for rest
+        // z for end rest, which is added internally to stop speaker crackle at the end
+        switch (c) {
+        case 'A':
+        case 'a':
+            note_freq = 440.0f;
+            break;
+        case 'B':
+        case 'b':
+            note_freq = 493.88f;
+            break;
+        case 'C':
+        case 'c':
+            note_freq = 523.25f;
+            break;
+        case 'D':
+        case 'd':
+            note_freq = 587.33f;
+            break;
+        case 'E':
+        case 'e':
+            note_freq = 659.25f;
+            break;
+        case 'F':
+        case 'f':
+            note_freq = 698.46f;
+            break;
+        case 'G':
+        case 'g':
+            note_freq = 783.99f;
+            break;
+        case 'z':
+            duration_s = 0.2f;
+            // Fallthrough
+        case 'R':
+        case 'r':
+            note_freq = 0;
+            break;
+        default:
+            // If we reach here then we have a syntax error
+            consumed = pos;
+            return syntax_error;
+        }
+
+        // Adjust frequency for octave
+        note_freq *= (float)(1 << (octave - 4));
+        pos++;
+
+        float dot_duration = duration_s;
+
+        // Note modifiers
+        while (pos < len) {
+            c = text[pos];
+
+            // Duration
+            int frac_duration;
+            if (read_number(text, len, pos, frac_duration)) {
+                if (frac_duration >= 1 && frac_duration <= 2000) {
+                    duration_s = duration_s * (4.0f / frac_duration);
+                }
+                continue;
+            }
+
+            // Dot
+            if (c == '.') {
+                dot_duration /= 2;
+                duration_s += dot_duration;
+                pos++;
+                continue;
+            }
+
+            // Octave
+            if (c == '>') {
+                note_freq *= 2;
+                pos++;
+                continue;
+            }
+            if (c == '<') {
+                note_freq /= 2;
+                pos++;
+                continue;
+            }
+
+            // Sharp/flat
+            if (c == '#' || c == '+') {
+                note_freq *= half_step;
+                pos++;
+                continue;
+            }
+            if (c == '-') {
+                note_freq /= half_step;
+                pos++;
+                continue;
+            }
+
+            break;
+        }
+
+        // More modifiers may follow in the next window
+        if (more_text && pos >= len) {
+            *this = before;
+            consumed = token_start;
+            return need_more;
+        }
+
+        note.frequency = (unsigned int)roundf(note_freq);
+        note.duration = (unsigned int)(duration_s * 1000);
+        note.volume = volume;
+        note.envelope = envelope;
+        consumed = pos;
+        return note_found;
+    }
+
+    // The last command ran to the end of the text, so its number may carry on
+    if (more_text && pos >= len && len > 0 && !isspace((unsigned char)text[len - 1])) {
+        *this = before;
+        consumed = token_start;
+        return need_more;
+    }
+
+    // A command was missing its number
+    if (pos < len) {
+        consumed = pos;
+        return syntax_error;
+    }
+
+    consumed = len;
+    return end_of_notes;
+}
+
+}; // namespace YAudio
@@ -0,0 +1,55 @@
+#ifndef YNOTES_H
+#define YNOTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ysynth.h"
+
+// The note parser has no Arduino or FreeRTOS dependencies, so it can be compiled and
+// exercised on a host machine.
+
+namespace YAudio {
+
+typedef struct {
+    unsigned int frequency;
+    unsigned int duration;
+    uint8_t volume;
+    envelope_t envelope;
+} note_t;
+
+class NoteParser {
+  public:
+    enum result {
+        note_found,   // A note (or rest) was parsed into the note argument
+        end_of_notes, // Only whitespace and commands were left
+        syntax_error, // consumed points at the offending character
+        need_more,    // The text ends part way through a note or command
+    };
+
+    NoteParser();
+
+    // Resets octave, tempo, volume and envelope to their default values
+    void reset();
+
+    // Parses the next note from the first len characters of text. Any commands before
+    // the note are applied to the parser state. consumed is set to the number of
+    // characters used, which the caller should drop before the next call.
+    //
+    // Set more_text if text is a window onto a longer program, for example one being
+    // read from a file. As a note or command that runs to the end of the window may be
+    // cut short, it is left unparsed and need_more is returned; the caller should drop
+    // the consumed characters, add more text after the rest, and call parse again.
+    result parse(const char *text, size_t len, note_t &note, size_t &consumed,
+                 bool more_text = false);
+
+  private:
+    int beats_per_minute;
+    int octave;
+    int volume;
+    envelope_t envelope;
+};
+
+}; // namespace YAudio
+
+#endif /* YNOTES_H */
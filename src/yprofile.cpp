@@ -0,0 +1,113 @@
+#include "yprofile.h"
+
+namespace YProfile {
+
+#if YBOARD_PROFILING
+///////////////////////////////// Profiling State /////////////////////////////
+
+static site_stats sites[num_sites];
+static uint32_t counters[num_counters];
+static portMUX_TYPE profile_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t cycles_per_us = 0;
+
+static const char *const site_names[num_sites] = {
+    "led_show", "mcp_read",   "accel_read",  "display_flush",
+    "sd_open",  "audio_copy", "mic_process",
+};
+
+static const char *const counter_names[num_counters] = {
+    "audio_stalls",
+    "audio_underruns",
+    "dropped_events",
+};
+
+////////////////////////////// Public Functions ///////////////////////////////
+void record(site s, uint32_t cycles) {
+    if (cycles_per_us == 0) {
+        cycles_per_us = ESP.getCpuFreqMHz();
+    }
+
+    // Find the histogram bucket from the position of the highest set bit
+    uint32_t us = cycles / cycles_per_us;
+    int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    if (bucket >= num_buckets) {
+        bucket = num_buckets - 1;
+    }
+
+    portENTER_CRITICAL(&profile_lock);
+    site_stats &stats = sites[s];
+    if (stats.calls == 0 || cycles < stats.min_cycles) {
+        stats.min_cycles = cycles;
+    }
+    if (cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+    stats.calls++;
+    stats.total_cycles += cycles;
+    stats.histogram[bucket]++;
+    portEXIT_CRITICAL(&profile_lock);
+}
+
+void count(counter c, uint32_t amount) {
+    portENTER_CRITICAL(&profile_lock);
+    counters[c] += amount;
+    portEXIT_CRITICAL(&profile_lock);
+}
+
+site_stats get_site_stats(site s) {
+    portENTER_CRITICAL(&profile_lock);
+    site_stats stats = sites[s];
+    portEXIT_CRITICAL(&profile_lock);
+    return stats;
+}
+
+uint32_t get_counter(counter c) { return counters[c]; }
+
+void reset() {
+    portENTER_CRITICAL(&profile_lock);
+    memset(sites, 0, sizeof(sites));
+    memset(counters, 0, sizeof(counters));
+    portEXIT_CRITICAL(&profile_lock);
+}
+
+void print_report(Print &out) {
+    uint32_t mhz = ESP.getCpuFreqMHz();
+
+    out.println("Call site         calls     avg us     min us     max us");
+    for (int i = 0; i < num_sites; i++) {
+        site_stats stats = get_site_stats(static_cast<site>(i));
+        if (stats.calls == 0) {
+            continue;
+        }
+
+        out.printf("%-14s %8lu %10lu %10lu %10lu\n", site_names[i], (unsigned long)stats.calls,
+                   (unsigned long)(stats.total_cycles / stats.calls / mhz),
+                   (unsigned long)(stats.min_cycles / mhz),
+                   (unsigned long)(stats.max_cycles / mhz));
+
+        // Only print the populated part of the histogram
+        out.print("    histogram (<us:calls):");
+        for (int bucket = 0; bucket < num_buckets; bucket++) {
+            if (stats.histogram[bucket]) {
+                out.printf(" %lu:%lu", 1UL << bucket, (unsigned long)stats.histogram[bucket]);
+            }
+        }
+        out.println();
+    }
+
+    for (int i = 0; i < num_counters; i++) {
+        out.printf("%-16s %lu\n", counter_names[i], (unsigned long)counters[i]);
+    }
+}
+
+#else
+////////////////////////////// Public Functions ///////////////////////////////
+void record(site s, uint32_t cycles) {}
+void count(counter c, uint32_t amount) {}
+site_stats get_site_stats(site s) { return site_stats(); }
+uint32_t get_counter(counter c) { return 0; }
+void reset() {}
+void print_report(Print &out) { out.println("Profiling disabled (YBOARD_PROFILING=0)"); }
+#endif
+
+}; // namespace YProfile
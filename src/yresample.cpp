@@ -0,0 +1,66 @@
+#include "yresample.h"
+
+namespace YAudio {
+
+static const uint32_t phase_one = 1 << 16;
+
+Resampler::Resampler() { configure(1, 1, 1); }
+
+void Resampler::configure(uint32_t in_rate, uint32_t out_rate, uint8_t new_channels) {
+    if (in_rate == 0 || out_rate == 0) {
+        in_rate = out_rate = 1;
+    }
+    if (new_channels < 1 || new_channels > max_channels) {
+        new_channels = 1;
+    }
+
+    step = ((uint64_t)in_rate << 16) / out_rate;
+    if (step == 0) {
+        step = 1;
+    }
+    channels = new_channels;
+    reset();
+}
+
+void Resampler::reset() {
+    // Starting from silence ramps into the first sample rather than jumping to it
+    phase = 0;
+    prev = 0;
+}
+
+size_t Resampler::process(const int16_t *in, size_t in_frames, int16_t *out, size_t max_out,
+                          size_t &consumed) {
+    size_t written = 0;
+    size_t frame = 0;
+
+    for (; frame < in_frames; frame++) {
+        // Mix the frame down to mono
+        const int16_t *samples = in + frame * channels;
+        int32_t next = samples[0];
+        if (channels > 1) {
+            for (int c = 1; c < channels; c++) {
+                next += samples[c];
+            }
+            next /= channels;
+        }
+
+        // Output every sample that falls between prev and next
+        while (phase < phase_one) {
+            if (written == max_out) {
+                consumed = frame;
+                return written;
+            }
+            // Drop a bit of the phase so the product fits in 32 bits
+            out[written++] = prev + (((next - prev) * (int32_t)(phase >> 1)) >> 15);
+            phase += step;
+        }
+
+        phase -= phase_one;
+        prev = next;
+    }
+
+    consumed = frame;
+    return written;
+}
+
+}; // namespace YAudio
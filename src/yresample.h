@@ -0,0 +1,45 @@
+#ifndef YRESAMPLE_H
+#define YRESAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The resampler has no Arduino or FreeRTOS dependencies, so it can be compiled and
+// exercised on a host machine.
+
+namespace YAudio {
+
+// Converts interleaved 16-bit audio at any sample rate to mono at a fixed output rate,
+// by linear interpolation in fixed point. The position between input frames is kept
+// from one block to the next, so a stream can be converted in blocks of any size.
+class Resampler {
+  public:
+    static constexpr int max_channels = 8;
+
+    Resampler();
+
+    // Sets the input and output rates and the number of input channels, and resets
+    // the position
+    void configure(uint32_t in_rate, uint32_t out_rate, uint8_t channels);
+
+    // Clears the interpolation history, for when a new stream starts
+    void reset();
+
+    // Converts up to in_frames frames from in into up to max_out samples in out. Returns
+    // the number of samples written, and sets consumed to the number of input frames
+    // used. Frames that weren't used should be passed in again on the next call.
+    size_t process(const int16_t *in, size_t in_frames, int16_t *out, size_t max_out,
+                   size_t &consumed);
+
+  private:
+    // Input frames to advance per output sample, and the position past prev, both in
+    // 16.16 fixed point
+    uint32_t step;
+    uint32_t phase;
+    int32_t prev;
+    uint8_t channels;
+};
+
+}; // namespace YAudio
+
+#endif /* YRESAMPLE_H */
@@ -0,0 +1,247 @@
+#include "ysynth.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace YAudio {
+
+// Envelope level at the peak of the attack. The top 16 bits are used as the gain.
+static const int32_t env_peak = 1 << 30;
+
+// One cycle of a sine wave, with the first sample repeated at the end so interpolation
+// never has to wrap
+static const int sine_bits = 8;
+static int16_t sine_table[(1 << sine_bits) + 1];
+static bool sine_table_ready = false;
+
+// Samples mixed at a time, to bound the stack used by render()
+static const size_t mix_block = 64;
+
+Synth::Synth() {
+    if (!sine_table_ready) {
+        for (int i = 0; i <= (1 << sine_bits); i++) {
+            sine_table[i] = (int16_t)lroundf(32767.0f * sinf(2.0f * (float)M_PI * i /
+                                                             (1 << sine_bits)));
+        }
+        sine_table_ready = true;
+    }
+
+    configure(44100);
+}
+
+void Synth::configure(uint32_t new_sample_rate) {
+    sample_rate = new_sample_rate ? new_sample_rate : 1;
+    note_counter = 0;
+    silence();
+}
+
+int Synth::note_on(float frequency, uint16_t amplitude, const envelope_t &envelope) {
+    // Prefer a free voice, then the quietest release, then the oldest note
+    int chosen = 0;
+    for (int i = 1; i < max_voices; i++) {
+        if (voice_before(voices[i], voices[chosen])) {
+            chosen = i;
+        }
+    }
+
+    voice_t &voice = voices[chosen];
+    voice.phase = 0;
+    voice.step = (uint32_t)(frequency * (4294967296.0f / sample_rate));
+    voice.amplitude = amplitude > 32767 ? 32767 : amplitude;
+    voice.level = 0;
+    voice.attack_samples = ms_to_samples(envelope.attack_ms);
+    voice.decay_samples = ms_to_samples(envelope.decay_ms);
+    voice.release_samples = ms_to_samples(envelope.release_ms);
+    voice.sustain_level =
+        (int32_t)(((int64_t)env_peak * (envelope.sustain > 100 ? 100 : envelope.sustain)) / 100);
+    voice.started = ++note_counter;
+    start_stage(voice, attack);
+
+    return chosen;
+}
+
+void Synth::note_off(int voice) {
+    if (voice < 0 || voice >= max_voices) {
+        return;
+    }
+    if (voices[voice].stage != idle && voices[voice].stage != release) {
+        start_stage(voices[voice], release);
+    }
+}
+
+void Synth::release_all() {
+    for (int i = 0; i < max_voices; i++) {
+        note_off(i);
+    }
+}
+
+void Synth::silence() {
+    memset(voices, 0, sizeof(voices));
+    for (voice_t &voice : voices) {
+        voice.stage = idle;
+    }
+}
+
+bool Synth::is_active() const {
+    for (const voice_t &voice : voices) {
+        if (voice.stage != idle) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Synth::render(int16_t *out, size_t samples) {
+    int32_t mix[mix_block];
+
+    while (samples > 0) {
+        size_t n = samples < mix_block ? samples : mix_block;
+        memset(mix, 0, n * sizeof(int32_t));
+
+        for (voice_t &voice : voices) {
+            if (voice.stage != idle) {
+                render_voice(voice, mix, n);
+            }
+        }
+
+        // Voices can add up to more than full scale, so clip rather than wrap
+        for (size_t i = 0; i < n; i++) {
+            int32_t sample = mix[i];
+            if (sample > 32767) {
+                sample = 32767;
+            } else if (sample < -32768) {
+                sample = -32768;
+            }
+            out[i] = sample;
+        }
+
+        out += n;
+        samples -= n;
+    }
+}
+
+// Order in which voices are taken for a new note: free voices, then releasing voices from
+// the quietest, then the rest from the oldest note
+bool Synth::voice_before(const voice_t &a, const voice_t &b) {
+    int rank_a = a.stage == idle ? 0 : (a.stage == release ? 1 : 2);
+    int rank_b = b.stage == idle ? 0 : (b.stage == release ? 1 : 2);
+    if (rank_a != rank_b) {
+        return rank_a < rank_b;
+    }
+    if (rank_a == 1) {
+        return a.level < b.level;
+    }
+    return (int32_t)(a.started - b.started) < 0;
+}
+
+uint32_t Synth::ms_to_samples(uint16_t ms) const {
+    return ((uint64_t)ms * sample_rate) / 1000;
+}
+
+// Sets the level change per sample so the stage reaches its target in the stage's length.
+// Stages with no length are skipped.
+void Synth::start_stage(voice_t &voice, stage_t stage) {
+    voice.stage = stage;
+
+    switch (stage) {
+    case attack:
+        if (voice.attack_samples == 0) {
+            voice.level = env_peak;
+            start_stage(voice, decay);
+            return;
+        }
+        voice.stage_left = voice.attack_samples;
+        voice.rate = (env_peak - voice.level) / (int32_t)voice.stage_left;
+        break;
+
+    case decay:
+        if (voice.decay_samples == 0) {
+            voice.level = voice.sustain_level;
+            start_stage(voice, sustain);
+            return;
+        }
+        voice.stage_left = voice.decay_samples;
+        voice.rate = (voice.sustain_level - voice.level) / (int32_t)voice.stage_left;
+        break;
+
+    case sustain:
+        // A note that decays to nothing is finished
+        if (voice.level == 0) {
+            voice.stage = idle;
+            return;
+        }
+        voice.stage_left = UINT32_MAX;
+        voice.rate = 0;
+        break;
+
+    case release:
+        if (voice.release_samples == 0 || voice.level == 0) {
+            voice.level = 0;
+            voice.stage = idle;
+            return;
+        }
+        voice.stage_left = voice.release_samples;
+        voice.rate = -voice.level / (int32_t)voice.stage_left;
+        break;
+
+    case idle:
+        break;
+    }
+}
+
+void Synth::render_voice(voice_t &voice, int32_t *mix, size_t samples) {
+    size_t done = 0;
+
+    while (done < samples && voice.stage != idle) {
+        // Within a run the envelope changes by the same amount every sample
+        size_t run = samples - done;
+        if (voice.stage_left < run) {
+            run = voice.stage_left;
+        }
+
+        uint32_t phase = voice.phase;
+        int32_t level = voice.level;
+        for (size_t i = 0; i < run; i++) {
+            // Interpolate between table entries using the next 16 bits of the phase
+            uint32_t index = phase >> (32 - sine_bits);
+            int32_t frac = (phase >> (16 - sine_bits)) & 0xFFFF;
+            int32_t a = sine_table[index];
+            int32_t b = sine_table[index + 1];
+            int32_t wave = a + (((b - a) * frac) >> 16);
+
+            int32_t sample = (wave * voice.amplitude) >> 15;
+            mix[done + i] += (sample * (level >> 15)) >> 15;
+
+            phase += voice.step;
+            level += voice.rate;
+        }
+        voice.phase = phase;
+        voice.level = level;
+
+        done += run;
+        voice.stage_left -= run;
+        if (voice.stage_left > 0) {
+            continue;
+        }
+
+        // Land exactly on the stage's target, whatever the rounding of the rate
+        switch (voice.stage) {
+        case attack:
+            voice.level = env_peak;
+            start_stage(voice, decay);
+            break;
+        case decay:
+            voice.level = voice.sustain_level;
+            start_stage(voice, sustain);
+            break;
+        case release:
+            voice.level = 0;
+            voice.stage = idle;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+}; // namespace YAudio
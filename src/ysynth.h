@@ -0,0 +1,89 @@
+#ifndef YSYNTH_H
+#define YSYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The synthesizer has no Arduino or FreeRTOS dependencies, so it can be compiled and
+// exercised on a host machine.
+
+namespace YAudio {
+
+// Attack, decay, sustain and release of a note. Times are in milliseconds, and sustain
+// is the level held after the decay, as a percentage of the peak.
+typedef struct {
+    uint16_t attack_ms;
+    uint16_t decay_ms;
+    uint8_t sustain;
+    uint16_t release_ms;
+} envelope_t;
+
+// Short enough not to soften the start or end of a note, but long enough not to click
+static const envelope_t default_envelope = {5, 0, 100, 20};
+
+// Plays sine wave notes on a few voices at once, each shaped by its own envelope, and
+// mixes them into 16-bit mono samples. Everything is done in fixed point. The envelope
+// is linear within each stage, so it is advanced by adding a step each sample, and the
+// step only has to be worked out when a stage starts.
+class Synth {
+  public:
+    static constexpr int max_voices = 4;
+
+    Synth();
+
+    // Sets the output sample rate and silences all voices
+    void configure(uint32_t sample_rate);
+
+    // Starts a note with the given peak amplitude (up to 32767) and returns the voice
+    // playing it. If every voice is busy, the quietest one is taken over.
+    int note_on(float frequency, uint16_t amplitude, const envelope_t &envelope);
+
+    // Moves the voice on to the release stage of its envelope
+    void note_off(int voice);
+    void release_all();
+
+    // Stops every voice immediately
+    void silence();
+
+    // Returns true while any voice is making sound, including releases
+    bool is_active() const;
+
+    // Writes the next samples of the mix to out
+    void render(int16_t *out, size_t samples);
+
+  private:
+    enum stage_t { idle, attack, decay, sustain, release };
+
+    typedef struct {
+        stage_t stage;
+        uint32_t phase; // Position in the sine wave, a full cycle is 2^32
+        uint32_t step;  // Phase advance per sample
+        int32_t amplitude;
+
+        // Envelope level (0 to env_peak), how much it changes each sample, and the samples
+        // left in the current stage
+        int32_t level;
+        int32_t rate;
+        uint32_t stage_left;
+
+        uint32_t attack_samples;
+        uint32_t decay_samples;
+        uint32_t release_samples;
+        int32_t sustain_level;
+
+        uint32_t started; // For finding the oldest voice
+    } voice_t;
+
+    uint32_t sample_rate;
+    uint32_t note_counter;
+    voice_t voices[max_voices];
+
+    static bool voice_before(const voice_t &a, const voice_t &b);
+    uint32_t ms_to_samples(uint16_t ms) const;
+    void start_stage(voice_t &voice, stage_t stage);
+    void render_voice(voice_t &voice, int32_t *mix, size_t samples);
+};
+
+}; // namespace YAudio
+
+#endif /* YSYNTH_H */
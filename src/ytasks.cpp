@@ -0,0 +1,205 @@
+#include "ytasks.h"
+
+namespace YTasks {
+
+// Per-task CPU time needs both of these FreeRTOS options
+#define YTASKS_CPU_STATS (configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY)
+
+///////////////////////////////// Task Registry ///////////////////////////////
+
+typedef struct {
+    const char *name; // NULL until the task starts, and once it has exited
+    TaskHandle_t handle;
+    uint32_t stack_size;
+    task_settings settings;
+    uint32_t last_run_time;
+} task_info_t;
+
+// A slot is used by one task at a time. FreeRTOS may still be using the control block of
+// a task that deleted itself until the idle task gets round to cleaning it up, and there
+// is no way to tell when that has happened, so the slot of a task that exits is never
+// handed out again. A task deleted by another task while it isn't running is cleaned up
+// straight away, so the slot of a stopped task can be.
+typedef struct {
+    task_info_t info;
+    bool started;
+
+    // FreeRTOS places the task control block in tcb, so the handle is its address
+    StaticTask_t tcb;
+    StackType_t stack[max_stack_size / sizeof(StackType_t)];
+} task_entry_t;
+
+static task_plan plan;
+static task_entry_t tasks[max_tasks];
+static portMUX_TYPE tasks_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if YTASKS_CPU_STATS
+static const int max_system_tasks = 32;
+static TaskStatus_t system_tasks[max_system_tasks];
+static uint32_t last_total_run_time = 0;
+#endif
+
+////////////////////////////// Public Functions ///////////////////////////////
+void set_plan(const task_plan &new_plan) { plan = new_plan; }
+
+const task_plan &get_plan() { return plan; }
+
+bool create(TaskFunction_t function, const char *name, uint32_t stack_size, void *arg,
+            const task_settings &settings, TaskHandle_t *handle) {
+    if (stack_size > max_stack_size) {
+        Serial.printf("ERROR: Stack for task %s too big (max %lu)\n", name,
+                      (unsigned long)max_stack_size);
+        return false;
+    }
+
+    task_entry_t *entry = NULL;
+    portENTER_CRITICAL(&tasks_lock);
+    for (task_entry_t &task : tasks) {
+        if (!task.started) {
+            entry = &task;
+            entry->info.name = name;
+            entry->info.handle = (TaskHandle_t)&entry->tcb;
+            entry->info.stack_size = stack_size;
+            entry->info.settings = settings;
+            entry->info.last_run_time = 0;
+            entry->started = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&tasks_lock);
+
+    if (entry == NULL) {
+        Serial.printf("ERROR: Too many tasks to create %s (max %d)\n", name, max_tasks);
+        return false;
+    }
+
+    xTaskCreateStaticPinnedToCore(function, name, stack_size / sizeof(StackType_t), arg,
+                                  settings.priority, entry->stack, &entry->tcb, settings.core);
+
+    if (handle) {
+        *handle = entry->info.handle;
+    }
+    return true;
+}
+
+void exit() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&tasks_lock);
+    for (task_entry_t &task : tasks) {
+        if (task.info.name != NULL && task.info.handle == self) {
+            task.info.name = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&tasks_lock);
+
+    vTaskDelete(NULL);
+}
+
+void stop(TaskHandle_t handle) {
+    task_entry_t *entry = NULL;
+    portENTER_CRITICAL(&tasks_lock);
+    for (task_entry_t &task : tasks) {
+        if (task.started && task.info.handle == handle) {
+            entry = &task;
+        }
+    }
+    portEXIT_CRITICAL(&tasks_lock);
+
+    if (entry == NULL) {
+        return;
+    }
+
+    // Wait until the task has blocked and switched out on its core. It can't run again
+    // after that, so vTaskDelete() cleans it up before returning.
+    while (true) {
+        eTaskState state = eTaskGetState(handle);
+        bool running = false;
+        for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+            running = running || xTaskGetCurrentTaskHandleForCPU(core) == handle;
+        }
+        if ((state == eBlocked || state == eSuspended) && !running) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    portENTER_CRITICAL(&tasks_lock);
+    entry->info.name = NULL;
+    portEXIT_CRITICAL(&tasks_lock);
+
+    vTaskDelete(handle);
+
+    portENTER_CRITICAL(&tasks_lock);
+    entry->started = false;
+    portEXIT_CRITICAL(&tasks_lock);
+}
+
+void print_report(Print &out) {
+    task_info_t snapshot[max_tasks];
+    uint32_t free_stack[max_tasks];
+    int count = 0;
+
+    // Tasks remove themselves under the lock before they are deleted, so every listed
+    // task is still running while it is held
+    portENTER_CRITICAL(&tasks_lock);
+    for (task_entry_t &task : tasks) {
+        if (task.info.name != NULL) {
+            snapshot[count] = task.info;
+            free_stack[count] = uxTaskGetStackHighWaterMark(task.info.handle);
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&tasks_lock);
+
+#if YTASKS_CPU_STATS
+    uint32_t total_run_time;
+    UBaseType_t num_system_tasks =
+        uxTaskGetSystemState(system_tasks, max_system_tasks, &total_run_time);
+    uint32_t elapsed = total_run_time - last_total_run_time;
+    last_total_run_time = total_run_time;
+#endif
+
+    out.println("Task                 core  prio  stack  min free   cpu");
+    for (int i = 0; i < count; i++) {
+        const task_info_t &task = snapshot[i];
+
+        char core[12];
+        if (task.settings.core == tskNO_AFFINITY) {
+            strcpy(core, "any");
+        } else {
+            snprintf(core, sizeof(core), "%d", (int)task.settings.core);
+        }
+
+        out.printf("%-20s %4s %5u %6lu %9lu", task.name, core, (unsigned)task.settings.priority,
+                   (unsigned long)task.stack_size, (unsigned long)free_stack[i]);
+
+#if YTASKS_CPU_STATS
+        // Share of one core's time since the last report
+        for (UBaseType_t j = 0; j < num_system_tasks; j++) {
+            if (system_tasks[j].xHandle != task.handle) {
+                continue;
+            }
+
+            uint32_t run_time = system_tasks[j].ulRunTimeCounter;
+            uint32_t used = run_time - task.last_run_time;
+            uint32_t percent = elapsed ? ((uint64_t)used * 100) / elapsed : 0;
+            out.printf(" %4lu%%", (unsigned long)percent);
+
+            portENTER_CRITICAL(&tasks_lock);
+            for (task_entry_t &entry : tasks) {
+                if (entry.info.name != NULL && entry.info.handle == task.handle) {
+                    entry.info.last_run_time = run_time;
+                }
+            }
+            portEXIT_CRITICAL(&tasks_lock);
+            break;
+        }
+#else
+        out.print("     -");
+#endif
+        out.println();
+    }
+}
+
+}; // namespace YTasks
@@ -0,0 +1,27 @@
+// Time for the board-level paths that run most often: refreshing the cached IO values
+// from the GPIO expander, and committing a new LED frame
+
+#include "host_test.h"
+#include "yboard.h"
+
+int main() {
+    Yboard.setup();
+
+    const int iterations = 20000;
+    double ns = host_test::time_ns(iterations, [] { Yboard.recache_all_io_vals(); });
+    host_test::report("YBoardV4::recache_all_io_vals", ns);
+
+    // The inputs are active low, so the expander's pins all reading high means nothing
+    // is pressed. Button 1 is on pin 7.
+    CHECK(!Yboard.get_button(1));
+    Yboard.mcp.mock_set_gpio(0xFFFF & ~(1 << 7));
+    Yboard.recache_all_io_vals();
+    CHECK(Yboard.get_button(1));
+
+    uint8_t level = 0;
+    ns = host_test::time_ns(iterations, [&] { Yboard.set_all_leds_color(level++, 0, 255); });
+    host_test::report("YBoardV4::set_all_leds_color", ns);
+    CHECK(Yboard.get_led_current() > 0);
+
+    host_test::finish();
+}
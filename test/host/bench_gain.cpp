@@ -0,0 +1,69 @@
+// Per-sample cost of the volume stage, held steady, boosting and ramping, against a plain
+// floating point multiply with clipping
+
+#include "host_test.h"
+#include "ygain.h"
+
+#include <math.h>
+
+using namespace YAudio;
+
+static const size_t block_samples = 512;
+static const int iterations = 20000;
+
+static int16_t block[block_samples];
+
+static void fill_block() {
+    for (size_t i = 0; i < block_samples; i++) {
+        block[i] = (int16_t)(12000 * sin(i * 0.05));
+    }
+}
+
+static double time_gain(int32_t gain, bool ramping) {
+    Gain stage;
+    stage.set_ramp(block_samples);
+    stage.set_gain(gain);
+    fill_block();
+
+    int flip = 0;
+    double ns = host_test::time_ns(iterations, [&] {
+        // Asking for a different gain each block keeps it ramping the whole time
+        if (ramping) {
+            stage.set_gain((flip++ & 1) ? gain : gain / 2);
+        }
+        stage.process(block, block_samples);
+    });
+    return ns / block_samples;
+}
+
+static double time_float(float gain) {
+    fill_block();
+    double ns = host_test::time_ns(iterations, [&] {
+        for (size_t i = 0; i < block_samples; i++) {
+            float scaled = block[i] * gain;
+            block[i] = scaled > 32767.0f ? 32767 : scaled < -32768.0f ? -32768 : (int16_t)scaled;
+        }
+    });
+    return ns / block_samples;
+}
+
+int main() {
+    // Halving and doubling a sample give the expected results
+    Gain stage;
+    stage.set_ramp(1);
+    int16_t samples[4] = {1000, -1000, 30000, -30000};
+    stage.set_gain(Gain::unity / 2);
+    stage.process(samples, 2);
+    CHECK(samples[1] == -500);
+    stage.set_gain(Gain::unity * 2);
+    stage.process(samples + 2, 2);
+    CHECK(samples[2] == 32767 && samples[3] == -32768);
+
+    host_test::report("Gain::process, unity", time_gain(Gain::unity, false), "sample");
+    host_test::report("Gain::process, 0.5x", time_gain(Gain::unity / 2, false), "sample");
+    host_test::report("Gain::process, 4x", time_gain(Gain::unity * 4, false), "sample");
+    host_test::report("Gain::process, ramping", time_gain(Gain::unity * 4, true), "sample");
+    host_test::report("float multiply, 0.5x", time_float(0.5f), "sample");
+
+    host_test::finish();
+}
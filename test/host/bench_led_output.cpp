@@ -0,0 +1,57 @@
+// Time to commit an LED frame through the SPI DMA output, and through the FastLED output
+// the board falls back to when SPI can't be set up. The SPI time is the CPU time to
+// build and queue the frame. The time the frame then takes on the wire, which the CPU
+// doesn't wait for, is worked out from the SPI clock. The FastLED time is the host's
+// time to bit-bang the frame, so it shows the shape of the cost rather than the board's.
+
+#include "host_test.h"
+#include "yboard.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int iterations = 20000;
+
+static double time_commits() {
+    uint8_t level = 0;
+    return host_test::time_ns(iterations, [&] { Yboard.set_all_leds_color(level++, 64, 255); });
+}
+
+static void bench_spi() {
+    Yboard.setup();
+    mock_spi_stats before = mock_spi_get_stats();
+    host_test::report("LED commit, SPI DMA", time_commits(), "frame");
+
+    // Every commit is one transaction
+    mock_spi_stats after = mock_spi_get_stats();
+    uint32_t frames = after.transactions - before.transactions;
+    CHECK(frames == iterations);
+    if (frames > 0) {
+        double bits = (double)(after.bits - before.bits) / frames;
+        host_test::report("LED frame on the wire", bits * 1e9 / after.clock_speed_hz, "frame");
+    }
+}
+
+static void bench_fastled() {
+    mock_spi_fail_init(true);
+    Yboard.setup();
+    host_test::report("LED commit, FastLED fallback", time_commits(), "frame");
+    CHECK(mock_spi_get_stats().transactions == 0);
+}
+
+int main() {
+    // The board can only be set up once, so the fallback runs in its own process
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        bench_fastled();
+        host_test::finish();
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    bench_spi();
+    host_test::finish();
+}
@@ -0,0 +1,45 @@
+// Time to parse a note with NoteParser, the work done for every note that is played
+
+#include "host_test.h"
+#include "ynotes.h"
+
+#include <string.h>
+
+using namespace YAudio;
+
+static const char *const tune = "T144 O4 V7 C8 D8 E8 F8 G4 G4 A8 A8 A8 A8 G2 "
+                                "F8 F8 F8 F8 E4 E4 D8 D8 D8 D8 C2 "
+                                "O5 C#16 D#16 F16. R16 B-<8 C>8 V4 E4.. D4 C4 ";
+
+// Parses the whole tune and returns the number of notes in it
+static int parse_tune(NoteParser &parser) {
+    const char *text = tune;
+    size_t len = strlen(tune);
+    int notes = 0;
+
+    parser.reset();
+    while (true) {
+        note_t note;
+        size_t consumed;
+        NoteParser::result result = parser.parse(text, len, note, consumed);
+        text += consumed;
+        len -= consumed;
+        if (result != NoteParser::note_found) {
+            CHECK(result == NoteParser::end_of_notes);
+            return notes;
+        }
+        notes++;
+    }
+}
+
+int main() {
+    NoteParser parser;
+    int notes = parse_tune(parser);
+    CHECK(notes == 31);
+
+    const int iterations = 20000;
+    double ns = host_test::time_ns(iterations, [&] { parse_tune(parser); });
+    host_test::report("NoteParser::parse", ns / notes, "note");
+
+    host_test::finish();
+}
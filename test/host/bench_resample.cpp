@@ -0,0 +1,87 @@
+// Resampler throughput, and how closely it reproduces a sine wave at each input rate
+
+#include "host_test.h"
+#include "yresample.h"
+
+#include <math.h>
+#include <vector>
+
+using namespace YAudio;
+
+static const uint32_t out_rate = 44100;
+static const float tone_hz = 1000.0f;
+static const float amplitude = 16000.0f;
+
+// One second of a sine wave at rate, the same on every channel
+static std::vector<int16_t> make_sine(uint32_t rate, uint8_t channels) {
+    std::vector<int16_t> samples(rate * channels);
+    for (uint32_t frame = 0; frame < rate; frame++) {
+        int16_t sample = lround(amplitude * sin(2.0 * M_PI * tone_hz * frame / rate));
+        for (int c = 0; c < channels; c++) {
+            samples[frame * channels + c] = sample;
+        }
+    }
+    return samples;
+}
+
+// Converts all of in, a block at a time as the speaker does
+static size_t convert(Resampler &resampler, const std::vector<int16_t> &in, uint8_t channels,
+                      std::vector<int16_t> &out) {
+    size_t frames = in.size() / channels;
+    size_t done = 0;
+    size_t written = 0;
+    while (done < frames) {
+        size_t consumed;
+        written += resampler.process(&in[done * channels], frames - done, &out[written],
+                                     std::min<size_t>(512, out.size() - written), consumed);
+        done += consumed;
+        if (written == out.size()) {
+            break;
+        }
+    }
+    return written;
+}
+
+// Signal to noise ratio of the output against the ideal sine at the output rate, in dB.
+// Output sample n lies n * step input frames past the silence before the first frame.
+static double measure_snr(uint32_t in_rate, const std::vector<int16_t> &out, size_t count) {
+    double step = (double)(((uint64_t)in_rate << 16) / out_rate) / 65536.0;
+    double signal = 0, noise = 0;
+    for (size_t n = 16; n < count; n++) {
+        double frame = n * step - 1.0;
+        double ideal = amplitude * sin(2.0 * M_PI * tone_hz * frame / in_rate);
+        signal += ideal * ideal;
+        noise += (out[n] - ideal) * (out[n] - ideal);
+    }
+    return 10.0 * log10(signal / noise);
+}
+
+static void run(const char *name, uint32_t in_rate, uint8_t channels, double min_snr_db) {
+    std::vector<int16_t> in = make_sine(in_rate, channels);
+    std::vector<int16_t> out(out_rate + 16);
+    Resampler resampler;
+
+    resampler.configure(in_rate, out_rate, channels);
+    size_t count = convert(resampler, in, channels, out);
+    CHECK(count >= out_rate - 2 && count <= out_rate + 2);
+
+    double snr = measure_snr(in_rate, out, count);
+    printf("%-40s %12.1f dB SNR\n", name, snr);
+    CHECK(snr >= min_snr_db);
+
+    double ns = host_test::time_ns(20, [&] {
+        resampler.reset();
+        convert(resampler, in, channels, out);
+    });
+    ns /= count;
+    host_test::report(name, ns, "sample");
+    printf("%-40s %12.1f Msamples/s\n", name, 1000.0 / ns);
+}
+
+int main() {
+    run("Resampler, 22050 Hz mono", 22050, 1, 40.0);
+    run("Resampler, 44100 Hz stereo", 44100, 2, 85.0);
+    run("Resampler, 48000 Hz stereo", 48000, 2, 50.0);
+
+    host_test::finish();
+}
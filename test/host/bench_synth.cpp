@@ -0,0 +1,39 @@
+// Time to render tone samples with Synth, with one voice and with every voice playing
+
+#include "host_test.h"
+#include "ysynth.h"
+
+using namespace YAudio;
+
+static const size_t block_samples = 256;
+
+static double time_render(Synth &synth, int voices) {
+    static const float frequencies[] = {261.63f, 329.63f, 392.0f, 523.25f};
+    synth.configure(44100);
+    for (int i = 0; i < voices; i++) {
+        synth.note_on(frequencies[i], 8000, default_envelope);
+    }
+
+    int16_t block[block_samples];
+    const int iterations = 20000;
+    double ns = host_test::time_ns(iterations, [&] { synth.render(block, block_samples); });
+
+    // The notes are held, so they are still sounding
+    CHECK(synth.is_active());
+    bool silent = true;
+    for (int16_t sample : block) {
+        silent = silent && sample == 0;
+    }
+    CHECK(!silent);
+
+    return ns / block_samples;
+}
+
+int main() {
+    Synth synth;
+    host_test::report("Synth::render, 1 voice", time_render(synth, 1), "sample");
+    host_test::report("Synth::render, 4 voices", time_render(synth, Synth::max_voices),
+                      "sample");
+
+    host_test::finish();
+}
@@ -0,0 +1,54 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+// A few helpers shared by the host tests and benchmarks. A test program checks things
+// with CHECK and ends with host_test::finish(). A benchmark times a piece of work with
+// host_test::time_ns and reports it with host_test::report.
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace host_test {
+
+static int failures = 0;
+
+inline void check(bool ok, const char *expression, const char *file, int line) {
+    if (!ok) {
+        printf("%s:%d: CHECK failed: %s\n", file, line, expression);
+        failures++;
+    }
+}
+
+// Reports the checks and exits. The library's tasks never finish, so this leaves without
+// running static destructors, which could pull objects out from under them.
+[[noreturn]] inline void finish() {
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+    } else {
+        printf("All checks passed\n");
+    }
+    fflush(stdout);
+    _Exit(failures ? 1 : 0);
+}
+
+// Runs work iterations times and returns the average time per iteration in nanoseconds
+template <typename Work> double time_ns(int iterations, Work work) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        work();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+inline void report(const char *name, double ns_per_op, const char *op = "op") {
+    printf("%-40s %12.1f ns/%s\n", name, ns_per_op, op);
+}
+
+}; // namespace host_test
+
+#define CHECK(expression) host_test::check((expression), #expression, __FILE__, __LINE__)
+
+#endif /* HOST_TEST_H */
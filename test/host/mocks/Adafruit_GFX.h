@@ -0,0 +1,32 @@
+#ifndef MOCK_ADAFRUIT_GFX_H
+#define MOCK_ADAFRUIT_GFX_H
+
+#include <Arduino.h>
+
+// Text drawing state only. Printed text is dropped.
+class Adafruit_GFX : public Print {
+  public:
+    Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h) {}
+
+    size_t write(uint8_t c) override { return 1; }
+
+    void setCursor(int16_t x, int16_t y) {
+        cursor_x = x;
+        cursor_y = y;
+    }
+    void setTextColor(uint16_t color) { text_color = color; }
+    void setTextSize(uint8_t size) {}
+    void setTextWrap(bool wrap) {}
+    void setRotation(uint8_t rotation) { this->rotation = rotation; }
+
+    int16_t width() const { return _width; }
+    int16_t height() const { return _height; }
+
+  protected:
+    int16_t _width, _height;
+    int16_t cursor_x = 0, cursor_y = 0;
+    uint16_t text_color = 0;
+    uint8_t rotation = 0;
+};
+
+#endif /* MOCK_ADAFRUIT_GFX_H */
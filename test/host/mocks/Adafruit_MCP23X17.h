@@ -0,0 +1,30 @@
+#ifndef MOCK_ADAFRUIT_MCP23X17_H
+#define MOCK_ADAFRUIT_MCP23X17_H
+
+#include <Wire.h>
+
+// GPIO expander for the host build. Tests set the pin levels with mock_set_gpio.
+class Adafruit_MCP23X17 {
+  public:
+    bool begin_I2C(uint8_t i2c_addr = 0x20, TwoWire *wire = &Wire) { return true; }
+
+    void pinMode(uint8_t pin, uint8_t mode) {}
+    uint8_t digitalRead(uint8_t pin) { return (gpio >> pin) & 1; }
+    uint16_t readGPIOAB() {
+        reads++;
+        return gpio;
+    }
+
+    void setupInterrupts(bool mirroring, bool open_drain, uint8_t polarity) {}
+    void setupInterruptPin(uint8_t pin, uint8_t mode = CHANGE) {}
+    void clearInterrupts() {}
+
+    void mock_set_gpio(uint16_t value) { gpio = value; }
+    uint32_t mock_reads() const { return reads; }
+
+  private:
+    volatile uint16_t gpio = 0xFFFF;
+    volatile uint32_t reads = 0;
+};
+
+#endif /* MOCK_ADAFRUIT_MCP23X17_H */
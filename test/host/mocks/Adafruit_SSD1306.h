@@ -0,0 +1,57 @@
+#ifndef MOCK_ADAFRUIT_SSD1306_H
+#define MOCK_ADAFRUIT_SSD1306_H
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+
+// Like the real driver, each transfer runs the bus at wireClk and leaves it at restoreClk
+class Adafruit_SSD1306 : public Adafruit_GFX {
+  public:
+    Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi = &Wire, int8_t rst_pin = -1,
+                     uint32_t clk_during = 400000UL, uint32_t clk_after = 100000UL)
+        : Adafruit_GFX(w, h), wire(twi), wireClk(clk_during), restoreClk(clk_after) {}
+
+    bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0,
+               bool reset = true, bool periph_begin = true) {
+        return true;
+    }
+    void clearDisplay() {}
+    void display() {
+        transfer();
+        frames++;
+    }
+    void ssd1306_command(uint8_t c) { transfer(); }
+
+    // Number of display() calls
+    uint32_t mock_frames() const { return frames; }
+
+    // Bus clock during the last transfer, and the bus clock now
+    uint32_t mock_transfer_clock() const { return transfer_clock; }
+    uint32_t mock_bus_clock() const { return wire->getClock(); }
+
+  protected:
+    TwoWire *wire;
+    uint32_t wireClk;
+    uint32_t restoreClk;
+
+  private:
+    uint32_t frames = 0;
+    uint32_t transfer_clock = 0;
+
+    void transfer() {
+        wire->setClock(wireClk);
+        transfer_clock = wire->getClock();
+        wire->setClock(restoreClk);
+    }
+};
+
+#endif /* MOCK_ADAFRUIT_SSD1306_H */
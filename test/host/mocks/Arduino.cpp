@@ -0,0 +1,218 @@
+#include <Arduino.h>
+#include <ESP32Encoder.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <atomic>
+#include <chrono>
+#include <driver/gpio.h>
+#include <driver/spi_master.h>
+#include <esp_sleep.h>
+#include <mutex>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+TwoWire Wire(0);
+puType ESP32Encoder::useInternalWeakPullResistors = puType::down;
+ESP32Encoder *ESP32Encoder::mock_attached = NULL;
+
+static const auto start_time = std::chrono::steady_clock::now();
+
+static int64_t elapsed_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                start_time)
+        .count();
+}
+
+size_t Print::printf(const char *format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (len < 0) {
+        return 0;
+    }
+    return write((const uint8_t *)buffer, std::min((size_t)len, sizeof(buffer) - 1));
+}
+
+///////////////////////////////// Time /////////////////////////////////////////
+
+unsigned long millis() { return elapsed_ns() / 1000000; }
+
+unsigned long micros() { return elapsed_ns() / 1000; }
+
+int64_t esp_timer_get_time() { return elapsed_ns() / 1000; }
+
+uint32_t EspClass::getCycleCount() { return elapsed_ns() * getCpuFreqMHz() / 1000; }
+
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void delayMicroseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+///////////////////////////////// Pins /////////////////////////////////////////
+
+static const int num_pins = 49;
+static std::atomic<int> pin_levels[num_pins];
+static std::atomic<bool> pin_levels_set[num_pins];
+static void (*pin_handlers[num_pins])(void);
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) { mock_set_pin(pin, value); }
+
+int digitalRead(uint8_t pin) {
+    if (pin >= num_pins || !pin_levels_set[pin]) {
+        return HIGH;
+    }
+    return pin_levels[pin];
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    if (pin < num_pins) {
+        pin_handlers[pin] = handler;
+    }
+}
+
+void mock_set_pin(uint8_t pin, int value) {
+    if (pin < num_pins) {
+        pin_levels[pin] = value;
+        pin_levels_set[pin] = true;
+    }
+}
+
+void mock_interrupt(uint8_t pin) {
+    if (pin < num_pins && pin_handlers[pin]) {
+        pin_handlers[pin]();
+    }
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) { return ESP_OK; }
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type) { return ESP_OK; }
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num) { return ESP_OK; }
+
+///////////////////////////////// Sleep ////////////////////////////////////////
+
+esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) { return ESP_OK; }
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source) { return ESP_OK; }
+
+esp_err_t esp_light_sleep_start() { return ESP_OK; }
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return ESP_SLEEP_WAKEUP_TIMER; }
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    default:
+        return "ESP_FAIL";
+    }
+}
+
+///////////////////////////////// Heap /////////////////////////////////////////
+
+static std::atomic<uint32_t> heap_caps_allocations(0);
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    if (caps & MALLOC_CAP_SPIRAM) {
+        return NULL;
+    }
+
+    void *ptr = malloc(size);
+    if (ptr) {
+        heap_caps_allocations++;
+    }
+    return ptr;
+}
+
+void heap_caps_free(void *ptr) { free(ptr); }
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? 0 : 256 * 1024;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? 0 : 128 * 1024;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? 0 : 256 * 1024;
+}
+
+uint32_t mock_heap_caps_allocations() { return heap_caps_allocations; }
+
+///////////////////////////////// SPI //////////////////////////////////////////
+
+struct spi_device_t {
+    int clock_speed_hz;
+    spi_transaction_t *in_flight;
+};
+
+static std::mutex spi_lock;
+static spi_device_t spi_devices[4];
+static int num_spi_devices = 0;
+static mock_spi_stats spi_stats;
+static bool spi_fail_init = false;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config,
+                             int dma_channel) {
+    return spi_fail_init ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle) {
+    std::lock_guard<std::mutex> guard(spi_lock);
+    if (num_spi_devices == 4) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    spi_device_t *device = &spi_devices[num_spi_devices++];
+    device->clock_speed_hz = config->clock_speed_hz;
+    device->in_flight = NULL;
+    spi_stats.clock_speed_hz = config->clock_speed_hz;
+    *handle = device;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *transaction,
+                                 uint32_t ticks_to_wait) {
+    std::lock_guard<std::mutex> guard(spi_lock);
+    if (handle->in_flight) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->in_flight = transaction;
+    spi_stats.transactions++;
+    spi_stats.bits += transaction->length;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **transaction, uint32_t ticks_to_wait) {
+    std::lock_guard<std::mutex> guard(spi_lock);
+    if (!handle->in_flight) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    *transaction = handle->in_flight;
+    handle->in_flight = NULL;
+    return ESP_OK;
+}
+
+mock_spi_stats mock_spi_get_stats() {
+    std::lock_guard<std::mutex> guard(spi_lock);
+    return spi_stats;
+}
+
+void mock_spi_fail_init(bool fail) { spi_fail_init = fail; }
@@ -0,0 +1,117 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+// Arduino core for the host build. Serial goes to stdout, time comes from the host's
+// steady clock, and pins are plain values that tests can set.
+
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define IRAM_ATTR
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+class Print {
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t println() { return print("\r\n"); }
+    size_t println(const char *str) { return print(str) + println(); }
+    size_t println(int value) { return print(value) + println(); }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+
+    virtual size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int c = read();
+            if (c < 0) {
+                break;
+            }
+            buffer[count++] = (uint8_t)c;
+        }
+        return count;
+    }
+    size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t *buffer, size_t size) override {
+        return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+
+class EspClass {
+  public:
+    uint32_t getCpuFreqMHz() { return 240; }
+
+    // Counts at getCpuFreqMHz() from the host's steady clock
+    uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+// Sets the level digitalRead returns for a pin. Pins read HIGH until set.
+void mock_set_pin(uint8_t pin, int value);
+
+// Calls the handler attached to a pin, as if its interrupt had fired
+void mock_interrupt(uint8_t pin);
+
+#endif /* MOCK_ARDUINO_H */
@@ -0,0 +1,167 @@
+#include <AudioTools.h>
+#include <AudioTools/AudioCodecs/CodecWAV.h>
+#include <chrono>
+#include <thread>
+
+size_t I2SStream::write(const uint8_t *data, size_t len) {
+    bytes_written += len;
+    return len;
+}
+
+size_t I2SStream::readBytes(uint8_t *data, size_t len) {
+    int bytes_per_second = info.sample_rate * info.channels * info.bits_per_sample / 8;
+    std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)len * 1000000 /
+                                                          bytes_per_second));
+    memset(data, 0, len);
+    return len;
+}
+
+///////////////////////////////// EncodedAudioStream ///////////////////////////
+
+bool EncodedAudioStream::begin() {
+    if (decoder) {
+        decoder->begin();
+    }
+    if (encoder) {
+        encoder->setAudioInfo(info);
+        encoder->begin();
+    }
+    return true;
+}
+
+void EncodedAudioStream::end() {
+    if (decoder) {
+        decoder->end();
+    }
+    if (encoder) {
+        encoder->end();
+    }
+}
+
+size_t EncodedAudioStream::write(const uint8_t *data, size_t len) {
+    return decoder ? decoder->write(data, len) : encoder->write(data, len);
+}
+
+///////////////////////////////// StreamCopy ///////////////////////////////////
+
+size_t StreamCopy::copy() {
+    if (to == NULL || from == NULL) {
+        return 0;
+    }
+
+    int available = from->available();
+    if (available <= 0) {
+        return 0;
+    }
+
+    size_t read = from->readBytes(buffer.data(), std::min((size_t)available, buffer.size()));
+    size_t written = 0;
+    while (written < read) {
+        size_t n = to->write(buffer.data() + written, read - written);
+        if (n == 0) {
+            break;
+        }
+        written += n;
+    }
+    return written;
+}
+
+///////////////////////////////// WAV //////////////////////////////////////////
+
+static uint32_t read_le(const uint8_t *data, int bytes) {
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+static void write_le(uint8_t *data, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        data[i] = value >> (8 * i);
+    }
+}
+
+void WAVDecoder::begin() {
+    header_len = 0;
+    in_data = false;
+    data_left = 0;
+}
+
+size_t WAVDecoder::write(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    if (!in_data) {
+        size_t n = std::min(len, sizeof(header) - header_len);
+        memcpy(header + header_len, data, n);
+        header_len += n;
+
+        size_t before = header_len - n;
+        if (!parse_header()) {
+            return len;
+        }
+
+        // Whatever followed the header in this write is sample data
+        pos = header_len - before;
+        header_len = 0;
+    }
+
+    size_t n = std::min((size_t)data_left, len - pos);
+    if (output && n > 0) {
+        output->write(data + pos, n);
+    }
+    data_left -= n;
+    return len;
+}
+
+// Looks for the fmt and data chunks in the header read so far. Once the data chunk is
+// found, header_len is cut back to where its samples start.
+bool WAVDecoder::parse_header() {
+    if (header_len < 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    AudioInfo info;
+    size_t pos = 12;
+    while (pos + 8 <= header_len) {
+        uint32_t chunk_size = read_le(header + pos + 4, 4);
+        if (memcmp(header + pos, "fmt ", 4) == 0 && pos + 8 + 16 <= header_len) {
+            info.channels = read_le(header + pos + 10, 2);
+            info.sample_rate = read_le(header + pos + 12, 4);
+            info.bits_per_sample = read_le(header + pos + 22, 2);
+        } else if (memcmp(header + pos, "data", 4) == 0) {
+            in_data = true;
+            data_left = chunk_size;
+            header_len = pos + 8;
+            notify_audio_change(info);
+            return true;
+        }
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+    return false;
+}
+
+void WAVEncoder::begin() {
+    uint8_t header[44];
+    uint32_t byte_rate = info.sample_rate * info.channels * info.bits_per_sample / 8;
+
+    memcpy(header, "RIFF", 4);
+    write_le(header + 4, 0xFFFFFFFF, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_le(header + 16, 16, 4);
+    write_le(header + 20, 1, 2);
+    write_le(header + 22, info.channels, 2);
+    write_le(header + 24, info.sample_rate, 4);
+    write_le(header + 28, byte_rate, 4);
+    write_le(header + 32, info.channels * info.bits_per_sample / 8, 2);
+    write_le(header + 34, info.bits_per_sample, 2);
+    memcpy(header + 36, "data", 4);
+    write_le(header + 40, 0xFFFFFFFF, 4);
+
+    if (output) {
+        output->write(header, sizeof(header));
+    }
+}
+
+size_t WAVEncoder::write(const uint8_t *data, size_t len) {
+    return output ? output->write(data, len) : 0;
+}
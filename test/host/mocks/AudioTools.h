@@ -0,0 +1,207 @@
+#ifndef MOCK_AUDIOTOOLS_H
+#define MOCK_AUDIOTOOLS_H
+
+// The parts of AudioTools the library uses, for the host build. The speaker accepts
+// everything written to it at once, and the microphone delivers silence at its real
+// rate. StreamCopy and the WAV codecs work like the real ones for 8 and 16-bit PCM.
+
+#include <Arduino.h>
+#include <vector>
+
+#define LOGD(...)
+#define LOGI(...)
+#define LOGW(...)
+#define LOGE(...)
+
+struct AudioInfo {
+    int sample_rate = 44100;
+    int channels = 2;
+    int bits_per_sample = 16;
+
+    AudioInfo() {}
+    AudioInfo(int sample_rate, int channels, int bits_per_sample)
+        : sample_rate(sample_rate), channels(channels), bits_per_sample(bits_per_sample) {}
+
+    void copyFrom(const AudioInfo &info) {
+        sample_rate = info.sample_rate;
+        channels = info.channels;
+        bits_per_sample = info.bits_per_sample;
+    }
+
+    bool operator==(const AudioInfo &other) const {
+        return sample_rate == other.sample_rate && channels == other.channels &&
+               bits_per_sample == other.bits_per_sample;
+    }
+    bool operator!=(const AudioInfo &other) const { return !(*this == other); }
+};
+
+class AudioInfoSupport {
+  public:
+    virtual ~AudioInfoSupport() {}
+    virtual void setAudioInfo(AudioInfo info) = 0;
+    virtual AudioInfo audioInfo() = 0;
+};
+
+class AudioStream : public Stream, public AudioInfoSupport {
+  public:
+    virtual bool begin() { return true; }
+    virtual void end() {}
+
+    void setAudioInfo(AudioInfo new_info) override { info = new_info; }
+    AudioInfo audioInfo() override { return info; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t len) override { return 0; }
+    size_t readBytes(uint8_t *data, size_t len) override { return 0; }
+    using Stream::readBytes;
+    int available() override { return 0; }
+    int read() override { return -1; }
+
+  protected:
+    AudioInfo info;
+};
+
+///////////////////////////////// I2S //////////////////////////////////////////
+
+enum RxTxMode { TX_MODE, RX_MODE };
+enum I2SSignalType { Digital, PDM };
+enum I2SFormat { I2S_STD_FORMAT, I2S_LSB_FORMAT, I2S_MSB_FORMAT };
+
+struct I2SConfig : AudioInfo {
+    RxTxMode rx_tx_mode = TX_MODE;
+    I2SSignalType signal_type = Digital;
+    I2SFormat i2s_format = I2S_STD_FORMAT;
+    bool is_master = true;
+    int port_no = 0;
+    int pin_ws = -1;
+    int pin_bck = -1;
+    int pin_data = -1;
+    int buffer_count = 6;
+    int buffer_size = 512;
+};
+
+class I2SStream : public AudioStream {
+  public:
+    I2SConfig defaultConfig(RxTxMode mode) {
+        I2SConfig config;
+        config.rx_tx_mode = mode;
+        return config;
+    }
+
+    bool begin(I2SConfig new_config) {
+        config = new_config;
+        setAudioInfo(config);
+        return true;
+    }
+    bool begin() override { return begin(config); }
+
+    // Output is taken at once and counted
+    size_t write(const uint8_t *data, size_t len) override;
+
+    // Input is silence, delivered no faster than the configured rate
+    size_t readBytes(uint8_t *data, size_t len) override;
+    int available() override { return config.rx_tx_mode == RX_MODE ? config.buffer_size : 0; }
+
+    uint64_t mock_bytes_written() const { return bytes_written; }
+
+  private:
+    I2SConfig config;
+    volatile uint64_t bytes_written = 0;
+};
+
+///////////////////////////////// Codecs ///////////////////////////////////////
+
+class AudioDecoder {
+  public:
+    virtual ~AudioDecoder() {}
+
+    void setOutput(Print &out) { output = &out; }
+    void addNotifyAudioChange(AudioInfoSupport &target) { notify.push_back(&target); }
+
+    virtual void begin() {}
+    virtual void end() {}
+    virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+  protected:
+    Print *output = NULL;
+    std::vector<AudioInfoSupport *> notify;
+
+    void notify_audio_change(AudioInfo info) {
+        for (AudioInfoSupport *target : notify) {
+            target->setAudioInfo(info);
+        }
+    }
+};
+
+class AudioEncoder {
+  public:
+    virtual ~AudioEncoder() {}
+
+    void setOutput(Print &out) { output = &out; }
+    virtual void setAudioInfo(AudioInfo new_info) { info = new_info; }
+
+    virtual void begin() {}
+    virtual void end() {}
+    virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+  protected:
+    Print *output = NULL;
+    AudioInfo info;
+};
+
+// Writes through a decoder or an encoder to its output
+class EncodedAudioStream : public AudioStream {
+  public:
+    EncodedAudioStream(Print *out, AudioDecoder *decoder) : decoder(decoder) {
+        decoder->setOutput(*out);
+    }
+    EncodedAudioStream(Print *out, AudioEncoder *encoder) : encoder(encoder) {
+        encoder->setOutput(*out);
+    }
+
+    void addNotifyAudioChange(AudioInfoSupport &target) {
+        if (decoder) {
+            decoder->addNotifyAudioChange(target);
+        }
+    }
+
+    bool begin() override;
+    bool begin(AudioInfo new_info) {
+        setAudioInfo(new_info);
+        return begin();
+    }
+    void end() override;
+
+    size_t write(const uint8_t *data, size_t len) override;
+
+  private:
+    AudioDecoder *decoder = NULL;
+    AudioEncoder *encoder = NULL;
+};
+
+///////////////////////////////// Copying ///////////////////////////////////////
+
+// Copies up to one buffer from a stream to an output on each copy() call
+class StreamCopy {
+  public:
+    StreamCopy() : buffer(1024) {}
+
+    void begin(Print &to, Stream &from) {
+        this->to = &to;
+        this->from = &from;
+    }
+    void end() {
+        to = NULL;
+        from = NULL;
+    }
+    void resize(int size) { buffer.resize(size); }
+
+    size_t copy();
+
+  private:
+    Print *to = NULL;
+    Stream *from = NULL;
+    std::vector<uint8_t> buffer;
+};
+
+#endif /* MOCK_AUDIOTOOLS_H */
@@ -0,0 +1,12 @@
+#ifndef MOCK_CODECMP3HELIX_H
+#define MOCK_CODECMP3HELIX_H
+
+#include <AudioTools.h>
+
+// Takes MP3 data without decoding any of it
+class MP3DecoderHelix : public AudioDecoder {
+  public:
+    size_t write(const uint8_t *data, size_t len) override { return len; }
+};
+
+#endif /* MOCK_CODECMP3HELIX_H */
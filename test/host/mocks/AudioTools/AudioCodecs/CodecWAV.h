@@ -0,0 +1,28 @@
+#ifndef MOCK_CODECWAV_H
+#define MOCK_CODECWAV_H
+
+#include <AudioTools.h>
+
+// Reads a PCM WAV header, reports its format, and passes the samples on unchanged
+class WAVDecoder : public AudioDecoder {
+  public:
+    void begin() override;
+    size_t write(const uint8_t *data, size_t len) override;
+
+  private:
+    uint8_t header[512];
+    size_t header_len = 0;
+    bool in_data = false;
+    uint32_t data_left = 0;
+
+    bool parse_header();
+};
+
+// Writes a WAV header for the format it was begun with, then the samples
+class WAVEncoder : public AudioEncoder {
+  public:
+    void begin() override;
+    size_t write(const uint8_t *data, size_t len) override;
+};
+
+#endif /* MOCK_CODECWAV_H */
@@ -0,0 +1,30 @@
+#ifndef MOCK_ESP32ENCODER_H
+#define MOCK_ESP32ENCODER_H
+
+#include <stdint.h>
+
+enum class puType { up, down, none };
+
+// Rotary encoder for the host build. The count only changes when set, by the owner or
+// by a test through mock_attached, the encoder attached most recently.
+class ESP32Encoder {
+  public:
+    static puType useInternalWeakPullResistors;
+    static ESP32Encoder *mock_attached;
+
+    void attachHalfQuad(int a_pin, int b_pin) { mock_attached = this; }
+    int64_t getCount() { return count; }
+    int64_t clearCount() {
+        count = 0;
+        return 0;
+    }
+    int64_t setCount(int64_t value) {
+        count = value;
+        return value;
+    }
+
+  private:
+    volatile int64_t count = 0;
+};
+
+#endif /* MOCK_ESP32ENCODER_H */
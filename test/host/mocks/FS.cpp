@@ -0,0 +1,175 @@
+#include <FS.h>
+#include <SD.h>
+
+SDFS SD;
+
+namespace fs {
+
+struct FileHandle {
+    FS *fs;
+    std::shared_ptr<FileNode> node;
+    size_t pos;
+    bool open;
+    bool writable;
+
+    // Children of a directory, and the next one openNextFile returns
+    std::vector<std::shared_ptr<FileNode>> children;
+    size_t next_child;
+};
+
+static std::string parent_of(const std::string &path) {
+    size_t slash = path.rfind('/');
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static std::string normalise(const char *path) {
+    std::string result = path[0] == '/' ? path : std::string("/") + path;
+    if (result.size() > 1 && result.back() == '/') {
+        result.pop_back();
+    }
+    return result;
+}
+
+File FS::open_node(std::shared_ptr<FileNode> node, bool writable) {
+    std::shared_ptr<FileHandle> handle(new FileHandle{this, node, 0, true, writable, {}, 0});
+    if (node->directory) {
+        for (auto &entry : nodes) {
+            if (entry.first != "/" && parent_of(entry.first) == node->path) {
+                handle->children.push_back(entry.second);
+            }
+        }
+    }
+    return File(handle);
+}
+
+///////////////////////////////// File /////////////////////////////////////////
+
+File::operator bool() const { return handle && handle->open; }
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+    if (!*this || !handle->writable) {
+        return 0;
+    }
+
+    std::vector<uint8_t> &data = handle->node->data;
+    if (handle->pos + size > data.size()) {
+        data.resize(handle->pos + size);
+    }
+    memcpy(data.data() + handle->pos, buffer, size);
+    handle->pos += size;
+    return size;
+}
+
+int File::available() {
+    if (!*this) {
+        return 0;
+    }
+    return handle->node->data.size() - handle->pos;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+    size_t n = std::min(size, (size_t)available());
+    if (n > 0) {
+        memcpy(buffer, handle->node->data.data() + handle->pos, n);
+        handle->pos += n;
+    }
+    return n;
+}
+
+bool File::seek(uint32_t pos) {
+    if (!*this || pos > handle->node->data.size()) {
+        return false;
+    }
+    handle->pos = pos;
+    return true;
+}
+
+size_t File::position() const { return *this ? handle->pos : 0; }
+
+size_t File::size() const { return *this ? handle->node->data.size() : 0; }
+
+void File::close() {
+    if (handle) {
+        handle->open = false;
+    }
+}
+
+const char *File::path() const { return *this ? handle->node->path.c_str() : NULL; }
+
+const char *File::name() const {
+    if (!*this) {
+        return NULL;
+    }
+    const std::string &path = handle->node->path;
+    return path.c_str() + path.rfind('/') + 1;
+}
+
+bool File::isDirectory() const { return *this && handle->node->directory; }
+
+File File::openNextFile(const char *mode) {
+    if (!isDirectory() || handle->next_child >= handle->children.size()) {
+        return File();
+    }
+    return handle->fs->open_node(handle->children[handle->next_child++], false);
+}
+
+void File::rewindDirectory() {
+    if (isDirectory()) {
+        handle->next_child = 0;
+    }
+}
+
+///////////////////////////////// FS ///////////////////////////////////////////
+
+File FS::open(const char *path, const char *mode, bool create) {
+    std::string key = normalise(path);
+    bool writable = mode[0] == 'w' || mode[0] == 'a';
+    add_directories("/");
+
+    auto found = nodes.find(key);
+    if (found == nodes.end()) {
+        if (!writable) {
+            return File();
+        }
+        add_directories(parent_of(key));
+        found = nodes.emplace(key, std::make_shared<FileNode>(FileNode{key, false, {}})).first;
+    } else if (mode[0] == 'w' && !found->second->directory) {
+        found->second->data.clear();
+    }
+
+    open_count++;
+    File file = open_node(found->second, writable);
+    if (mode[0] == 'a') {
+        file.seek(file.size());
+    }
+    return file;
+}
+
+bool FS::exists(const char *path) { return nodes.count(normalise(path)) > 0; }
+
+bool FS::remove(const char *path) { return nodes.erase(normalise(path)) > 0; }
+
+void FS::mock_add_file(const std::string &path, const std::vector<uint8_t> &data) {
+    std::string key = normalise(path.c_str());
+    add_directories(parent_of(key));
+    nodes[key] = std::make_shared<FileNode>(FileNode{key, false, data});
+}
+
+void FS::mock_clear() { nodes.clear(); }
+
+void FS::add_directories(const std::string &path) {
+    if (nodes.count(path)) {
+        return;
+    }
+    if (path != "/") {
+        add_directories(parent_of(path));
+    }
+    nodes[path] = std::make_shared<FileNode>(FileNode{path, true, {}});
+}
+
+}; // namespace fs
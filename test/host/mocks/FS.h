@@ -0,0 +1,87 @@
+#ifndef MOCK_FS_H
+#define MOCK_FS_H
+
+// File system for the host build. Files live in memory, and are added by tests with
+// mock_add_file or by the library writing them. Handles share state when copied, as
+// Arduino's do, so closing one copy closes them all.
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+struct FileNode {
+    std::string path;
+    bool directory;
+    std::vector<uint8_t> data;
+};
+
+struct FileHandle;
+
+class File : public Stream {
+  public:
+    File() {}
+    explicit File(std::shared_ptr<FileHandle> handle) : handle(handle) {}
+
+    operator bool() const;
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    size_t read(uint8_t *buffer, size_t size);
+    size_t readBytes(uint8_t *buffer, size_t length) override { return read(buffer, length); }
+    using Stream::readBytes;
+
+    bool seek(uint32_t pos);
+    size_t position() const;
+    size_t size() const;
+    void flush() {}
+    void close();
+
+    const char *path() const;
+    const char *name() const;
+    bool isDirectory() const;
+    File openNextFile(const char *mode = FILE_READ);
+    void rewindDirectory();
+
+  private:
+    std::shared_ptr<FileHandle> handle;
+};
+
+class FS {
+  public:
+    File open(const char *path, const char *mode = FILE_READ, bool create = false);
+    bool exists(const char *path);
+    bool remove(const char *path);
+
+    // Adds or replaces a file, creating the directories above it
+    void mock_add_file(const std::string &path, const std::vector<uint8_t> &data);
+
+    // Removes every file
+    void mock_clear();
+
+    // Number of open calls that returned a file
+    uint32_t mock_open_count() const { return open_count; }
+
+  private:
+    std::map<std::string, std::shared_ptr<FileNode>> nodes;
+    uint32_t open_count = 0;
+
+    void add_directories(const std::string &path);
+    File open_node(std::shared_ptr<FileNode> node, bool writable);
+    friend class File;
+};
+
+}; // namespace fs
+
+using fs::File;
+
+#endif /* MOCK_FS_H */
@@ -0,0 +1,113 @@
+#include <FastLED.h>
+
+CFastLED FastLED;
+const CRGB CRGB::Black(0, 0, 0);
+
+// The pins FastLED would write, one bit at a time
+static volatile uint32_t gpio_out_register;
+
+uint8_t scale8(uint8_t i, uint8_t scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+
+uint8_t scale8_video(uint8_t i, uint8_t scale) {
+    return (((uint16_t)i * (uint16_t)scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+uint8_t triwave8(uint8_t in) {
+    if (in & 0x80) {
+        in = 255 - in;
+    }
+    return in << 1;
+}
+
+uint8_t ease8InOutCubic(uint8_t i) {
+    uint8_t ii = scale8(i, i);
+    uint8_t iii = scale8(ii, i);
+    uint16_t r1 = (3 * (uint16_t)ii) - (2 * (uint16_t)iii);
+    if (r1 & 0x100) {
+        return 255;
+    }
+    return r1;
+}
+
+uint8_t cubicwave8(uint8_t in) { return ease8InOutCubic(triwave8(in)); }
+
+uint8_t blend8(uint8_t a, uint8_t b, uint8_t amount_of_b) {
+    uint16_t partial = (a << 8) | b;
+    partial += b * amount_of_b;
+    partial -= a * amount_of_b;
+    return partial >> 8;
+}
+
+CRGB blend(const CRGB &p1, const CRGB &p2, uint8_t amount_of_p2) {
+    return CRGB(blend8(p1.r, p2.r, amount_of_p2), blend8(p1.g, p2.g, amount_of_p2),
+                blend8(p1.b, p2.b, amount_of_p2));
+}
+
+void fill_solid(CRGB *leds, int num_leds, const CRGB &color) {
+    for (int i = 0; i < num_leds; i++) {
+        leds[i] = color;
+    }
+}
+
+CRGB &CRGB::operator=(const CHSV &hsv) {
+    // Six 43-step sectors around the colour wheel
+    uint8_t sector = hsv.h / 43;
+    uint8_t offset = (hsv.h - sector * 43) * 6;
+    uint8_t low = scale8(hsv.v, 255 - hsv.s);
+    uint8_t falling = scale8(hsv.v, 255 - scale8(hsv.s, offset));
+    uint8_t rising = scale8(hsv.v, 255 - scale8(hsv.s, 255 - offset));
+
+    switch (sector) {
+    case 0:
+        r = hsv.v, g = rising, b = low;
+        break;
+    case 1:
+        r = falling, g = hsv.v, b = low;
+        break;
+    case 2:
+        r = low, g = hsv.v, b = rising;
+        break;
+    case 3:
+        r = low, g = falling, b = hsv.v;
+        break;
+    case 4:
+        r = rising, g = low, b = hsv.v;
+        break;
+    default:
+        r = hsv.v, g = low, b = falling;
+        break;
+    }
+    return *this;
+}
+
+void CFastLED::add_apa102(CRGB *new_leds, int new_num_leds, EOrder new_order) {
+    leds = new_leds;
+    num_leds = new_num_leds;
+    order = new_order;
+}
+
+static void write_byte(uint8_t value) {
+    for (int bit = 7; bit >= 0; bit--) {
+        gpio_out_register = (value >> bit) & 1;
+        gpio_out_register |= 2;
+        gpio_out_register &= ~2u;
+    }
+}
+
+void CFastLED::show(uint8_t scale) {
+    for (int i = 0; i < 4; i++) {
+        write_byte(0);
+    }
+
+    for (int i = 0; i < num_leds; i++) {
+        const CRGB &led = leds[i];
+        write_byte(0xFF);
+        for (int shift = 6; shift >= 0; shift -= 3) {
+            write_byte(scale8(led.raw[(order >> shift) & 7], scale));
+        }
+    }
+
+    for (int i = 0; i < (num_leds + 15) / 16 + 1; i++) {
+        write_byte(0xFF);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef MOCK_FASTLED_H
+#define MOCK_FASTLED_H
+
+// FastLED for the host build. The 8-bit maths matches FastLED's portable C versions, so
+// colours and animation levels come out as they do on the board. HSV colours use a plain
+// spectrum conversion rather than FastLED's rainbow one.
+
+#include <Arduino.h>
+
+uint8_t scale8(uint8_t i, uint8_t scale);
+uint8_t scale8_video(uint8_t i, uint8_t scale);
+uint8_t triwave8(uint8_t in);
+uint8_t ease8InOutCubic(uint8_t i);
+uint8_t cubicwave8(uint8_t in);
+uint8_t blend8(uint8_t a, uint8_t b, uint8_t amount_of_b);
+
+struct CHSV {
+    uint8_t h, s, v;
+
+    CHSV() : h(0), s(0), v(0) {}
+    CHSV(uint8_t h, uint8_t s, uint8_t v) : h(h), s(s), v(v) {}
+};
+
+struct CRGB {
+    union {
+        struct {
+            uint8_t r, g, b;
+        };
+        uint8_t raw[3];
+    };
+
+    CRGB() : r(0), g(0), b(0) {}
+    CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+    CRGB(const CHSV &hsv) { *this = hsv; }
+
+    CRGB &operator=(const CHSV &hsv);
+
+    uint8_t &operator[](int i) { return raw[i]; }
+    const uint8_t &operator[](int i) const { return raw[i]; }
+
+    bool operator==(const CRGB &other) const {
+        return r == other.r && g == other.g && b == other.b;
+    }
+    bool operator!=(const CRGB &other) const { return !(*this == other); }
+
+    CRGB &nscale8_video(uint8_t scale) {
+        r = scale8_video(r, scale);
+        g = scale8_video(g, scale);
+        b = scale8_video(b, scale);
+        return *this;
+    }
+
+    static const CRGB Black;
+};
+
+CRGB blend(const CRGB &p1, const CRGB &p2, uint8_t amount_of_p2);
+void fill_solid(CRGB *leds, int num_leds, const CRGB &color);
+
+enum EOrder { RGB = 0012, BGR = 0210 };
+enum ESPIChipsets { APA102 };
+
+class CFastLED {
+  public:
+    template <ESPIChipsets CHIPSET, uint8_t DATA_PIN, uint8_t CLOCK_PIN, EOrder ORDER>
+    void addLeds(CRGB *leds, int num_leds) {
+        add_apa102(leds, num_leds, ORDER);
+    }
+
+    // Sends the LEDs by bit-banging the data and clock pins, as FastLED does for APA102
+    // strips on pins without a hardware SPI mapping
+    void show(uint8_t brightness);
+    void show() { show(brightness); }
+
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() { return brightness; }
+
+  private:
+    CRGB *leds = NULL;
+    int num_leds = 0;
+    EOrder order = RGB;
+    uint8_t brightness = 255;
+
+    void add_apa102(CRGB *leds, int num_leds, EOrder order);
+};
+
+extern CFastLED FastLED;
+
+#endif /* MOCK_FASTLED_H */
@@ -0,0 +1,75 @@
+#include <Arduino.h>
+#include <IRrecv.h>
+#include <IRsend.h>
+
+// NEC timings in microseconds
+static const uint16_t header_mark_us = 9000;
+static const uint16_t header_space_us = 4500;
+static const uint16_t bit_mark_us = 560;
+static const uint16_t one_space_us = 1690;
+static const uint16_t zero_space_us = 560;
+static const uint32_t frame_us = 108000;
+
+bool IRrecv::decode(decode_results *results, void *save, uint8_t max_skip,
+                    uint16_t noise_floor) {
+    frame next;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (frames.empty()) {
+            return false;
+        }
+        next = frames.front();
+        frames.pop_front();
+    }
+
+    // Capture the timings, with the unused first entry real captures have
+    uint16_t len = 0;
+    capture[len++] = 0;
+    capture[len++] = header_mark_us;
+    capture[len++] = header_space_us;
+    for (int bit = next.bits - 1; bit >= 0 && len + 2 <= buffer_size; bit--) {
+        capture[len++] = bit_mark_us;
+        capture[len++] = ((next.value >> bit) & 1) ? one_space_us : zero_space_us;
+    }
+
+    results->decode_type = next.type;
+    results->value = next.value;
+    results->address = 0;
+    results->command = 0;
+    results->bits = next.bits;
+    results->rawbuf = capture;
+    results->rawlen = len;
+    results->overflow = false;
+    results->repeat = false;
+    return true;
+}
+
+void IRrecv::mock_receive(decode_type_t type, uint64_t value, uint16_t bits) {
+    std::lock_guard<std::mutex> guard(lock);
+    frames.push_back({type, value, bits});
+}
+
+void IRsend::mock_hold_value(uint64_t value) {
+    std::lock_guard<std::mutex> guard(hold_lock);
+    holding = true;
+    hold_value = value;
+}
+
+void IRsend::mock_release() {
+    std::lock_guard<std::mutex> guard(hold_lock);
+    holding = false;
+    released.notify_all();
+}
+
+bool IRsend::send(decode_type_t type, uint64_t data, uint16_t nbits, uint16_t repeat) {
+    {
+        std::unique_lock<std::mutex> guard(hold_lock);
+        released.wait(guard, [&] { return !holding || data != hold_value; });
+    }
+
+    delayMicroseconds(frame_us * (repeat + 1));
+    last_type = type;
+    last_value = data;
+    sent++;
+    return type != UNKNOWN && type != UNUSED && data != fail_value;
+}
@@ -0,0 +1,63 @@
+#ifndef MOCK_IRRECV_H
+#define MOCK_IRRECV_H
+
+#include <IRremoteESP8266.h>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+
+const uint16_t kStateSizeMax = 53;
+
+class decode_results {
+  public:
+    decode_type_t decode_type;
+    union {
+        struct {
+            uint64_t value;
+            uint32_t address;
+            uint32_t command;
+        };
+        uint8_t state[kStateSizeMax];
+    };
+    uint16_t bits;
+    volatile uint16_t *rawbuf;
+    uint16_t rawlen;
+    bool overflow;
+    bool repeat;
+};
+
+// IR receiver for the host build. Tests queue up frames with mock_receive, and each
+// decode call hands out the next one. Like the real receiver, rawbuf points into the
+// receiver's own capture buffer, which the next capture overwrites.
+class IRrecv {
+  public:
+    IRrecv(uint16_t recv_pin, uint16_t buffer_size = 100, uint8_t timeout = 15,
+           bool save_buffer = false, uint8_t timer_num = 0)
+        : buffer_size(buffer_size < max_buffer_size ? buffer_size : max_buffer_size) {}
+
+    void enableIRIn(bool pullup = false) {}
+    void disableIRIn() {}
+    void resume() {}
+    bool decode(decode_results *results, void *save = NULL, uint8_t max_skip = 0,
+                uint16_t noise_floor = 0);
+
+    // Queues a frame for decode. Its raw timings are a header mark and space, then a mark
+    // and space for each bit of the value.
+    void mock_receive(decode_type_t type, uint64_t value, uint16_t bits);
+
+  private:
+    static const uint16_t max_buffer_size = 1024;
+
+    struct frame {
+        decode_type_t type;
+        uint64_t value;
+        uint16_t bits;
+    };
+
+    uint16_t buffer_size;
+    uint16_t capture[max_buffer_size];
+    std::mutex lock;
+    std::deque<frame> frames;
+};
+
+#endif /* MOCK_IRRECV_H */
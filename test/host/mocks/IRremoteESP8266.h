@@ -0,0 +1,15 @@
+#ifndef MOCK_IRREMOTEESP8266_H
+#define MOCK_IRREMOTEESP8266_H
+
+#include <stdint.h>
+
+enum decode_type_t {
+    UNKNOWN = -1,
+    UNUSED = 0,
+    RC5,
+    RC6,
+    NEC,
+    SONY,
+};
+
+#endif /* MOCK_IRREMOTEESP8266_H */
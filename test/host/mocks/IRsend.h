@@ -0,0 +1,38 @@
+#ifndef MOCK_IRSEND_H
+#define MOCK_IRSEND_H
+
+#include <IRremoteESP8266.h>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+
+// IR transmitter for the host build. Sending takes as long as an NEC frame, and the
+// last frame sent is kept for tests to check. Tests can make sends of one value fail,
+// and hold sends of one value until they let them go.
+class IRsend {
+  public:
+    explicit IRsend(uint16_t ir_send_pin, bool inverted = false, bool use_modulation = true) {}
+
+    void begin() {}
+    bool send(decode_type_t type, uint64_t data, uint16_t nbits, uint16_t repeat = 0);
+
+    decode_type_t mock_last_type() const { return last_type; }
+    uint64_t mock_last_value() const { return last_value; }
+    uint32_t mock_sent() const { return sent; }
+    void mock_fail_value(uint64_t value) { fail_value = value; }
+    void mock_hold_value(uint64_t value);
+    void mock_release();
+
+  private:
+    volatile decode_type_t last_type = UNUSED;
+    volatile uint64_t last_value = 0;
+    volatile uint32_t sent = 0;
+    volatile uint64_t fail_value = 0;
+
+    std::mutex hold_lock;
+    std::condition_variable released;
+    bool holding = false;
+    uint64_t hold_value = 0;
+};
+
+#endif /* MOCK_IRSEND_H */
@@ -0,0 +1,6 @@
+#ifndef MOCK_IRUTILS_H
+#define MOCK_IRUTILS_H
+
+#include <IRremoteESP8266.h>
+
+#endif /* MOCK_IRUTILS_H */
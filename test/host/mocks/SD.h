@@ -0,0 +1,19 @@
+#ifndef MOCK_SD_H
+#define MOCK_SD_H
+
+#include <FS.h>
+#include <SPI.h>
+
+class SDFS : public fs::FS {
+  public:
+    bool begin(uint8_t ss_pin = 5, SPIClass &spi = SPI, uint32_t frequency = 4000000,
+               const char *mountpoint = "/sd", uint8_t max_files = 5,
+               bool format_if_empty = false) {
+        return true;
+    }
+    void end() {}
+};
+
+extern SDFS SD;
+
+#endif /* MOCK_SD_H */
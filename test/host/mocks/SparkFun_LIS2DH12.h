@@ -0,0 +1,16 @@
+#ifndef MOCK_SPARKFUN_LIS2DH12_H
+#define MOCK_SPARKFUN_LIS2DH12_H
+
+#include <Wire.h>
+
+// Accelerometer for the host build, lying flat and still
+class SPARKFUN_LIS2DH12 {
+  public:
+    bool begin(uint8_t address = 0x19, TwoWire &wire = Wire) { return true; }
+    bool available() { return true; }
+    float getX() { return 0; }
+    float getY() { return 0; }
+    float getZ() { return 1000; }
+};
+
+#endif /* MOCK_SPARKFUN_LIS2DH12_H */
@@ -0,0 +1,37 @@
+#ifndef MOCK_WIRE_H
+#define MOCK_WIRE_H
+
+#include <Arduino.h>
+
+// I2C bus for the host build. No devices answer on it, the device mocks stand in for them.
+class TwoWire : public Stream {
+  public:
+    explicit TwoWire(uint8_t bus_num) : bus_num(bus_num) {}
+
+    bool begin(int sda, int scl, uint32_t frequency = 0) {
+        if (frequency) {
+            clock = frequency;
+        }
+        return true;
+    }
+    bool setClock(uint32_t frequency) {
+        clock = frequency;
+        return true;
+    }
+    uint32_t getClock() { return clock; }
+
+    void beginTransmission(uint8_t address) {}
+    uint8_t endTransmission(bool send_stop = true) { return 2; }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t c) override { return 1; }
+
+  private:
+    uint8_t bus_num;
+    uint32_t clock = 100000;
+};
+
+extern TwoWire Wire;
+
+#endif /* MOCK_WIRE_H */
@@ -0,0 +1,71 @@
+#ifndef MOCK_DRIVER_SPI_MASTER_H
+#define MOCK_DRIVER_SPI_MASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// SPI master driver for the host build. Queued transactions complete at once, and the
+// driver keeps counts of what was sent so tests can check it.
+
+typedef enum { SPI1_HOST, SPI2_HOST, SPI3_HOST } spi_host_device_t;
+
+#define SPI_DMA_CH_AUTO 3
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+} spi_bus_config_t;
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    int clock_speed_hz;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+} spi_device_interface_config_t;
+
+typedef struct {
+    uint32_t flags;
+    size_t length;
+    size_t rxlength;
+    void *user;
+    const void *tx_buffer;
+    void *rx_buffer;
+} spi_transaction_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+#define SPI_DEVICE_HALFDUPLEX (1 << 4)
+#define SPI_DEVICE_NO_DUMMY (1 << 6)
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config,
+                             int dma_channel);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *transaction,
+                                 uint32_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **transaction, uint32_t ticks_to_wait);
+
+struct mock_spi_stats {
+    uint32_t transactions; // Transactions queued
+    uint64_t bits;         // Bits sent by them
+    int clock_speed_hz;    // Clock of the last device added
+};
+
+mock_spi_stats mock_spi_get_stats();
+
+// Makes spi_bus_initialize fail, so callers take their fallback path
+void mock_spi_fail_init(bool fail);
+
+#endif /* MOCK_DRIVER_SPI_MASTER_H */
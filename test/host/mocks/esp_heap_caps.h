@@ -0,0 +1,24 @@
+#ifndef MOCK_ESP_HEAP_CAPS_H
+#define MOCK_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+// The host has no PSRAM, so MALLOC_CAP_SPIRAM allocations fail as they do on boards
+// without it. Everything else comes from malloc.
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+
+// Number of successful heap_caps_malloc calls so far
+uint32_t mock_heap_caps_allocations();
+
+#endif /* MOCK_ESP_HEAP_CAPS_H */
@@ -0,0 +1,9 @@
+#ifndef MOCK_ESP_TIMER_H
+#define MOCK_ESP_TIMER_H
+
+#include <stdint.h>
+
+// Microseconds since the program started
+int64_t esp_timer_get_time();
+
+#endif /* MOCK_ESP_TIMER_H */
@@ -0,0 +1,300 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <sched.h>
+#include <string.h>
+#include <thread>
+
+// Objects are constructed inside the callers' static buffers and never destroyed, so
+// tasks still blocked on them when the program exits don't touch freed memory.
+
+struct tskTaskControlBlock {
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notify_value = 0;
+    bool delete_requested = false;
+    bool deleted = false;
+    const char *name = NULL;
+};
+
+struct QueueDefinition {
+    std::mutex lock;
+    std::condition_variable changed;
+    uint8_t *storage = NULL;
+    UBaseType_t length = 0;
+    UBaseType_t item_size = 0;
+    UBaseType_t count = 0;
+    UBaseType_t head = 0;
+
+    // Mutexes remember their holder, so recursive mutexes can be taken again by it
+    bool recursive = false;
+    std::thread::id holder;
+    UBaseType_t depth = 0;
+};
+
+static_assert(sizeof(tskTaskControlBlock) <= sizeof(StaticTask_t), "StaticTask_t too small");
+static_assert(sizeof(QueueDefinition) <= sizeof(StaticQueue_t), "StaticQueue_t too small");
+
+// Thrown by vTaskDelete(NULL) to unwind the task's thread
+struct task_deleted {};
+
+static thread_local tskTaskControlBlock *current_task = NULL;
+static const auto start_time = std::chrono::steady_clock::now();
+
+// Waits on cv until ready() is true or the timeout passes. Returns ready().
+template <typename Ready>
+static bool wait(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                 TickType_t ticks, Ready ready) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+///////////////////////////////// Critical Sections ////////////////////////////
+
+void vPortEnterCritical(portMUX_TYPE *mux) {
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE *mux) { __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE); }
+
+///////////////////////////////// Tasks ////////////////////////////////////////
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char *name,
+                                           uint32_t stack_depth, void *arg,
+                                           UBaseType_t priority, StackType_t *stack,
+                                           StaticTask_t *task_buffer, BaseType_t core) {
+    tskTaskControlBlock *task = new (task_buffer) tskTaskControlBlock();
+    task->name = name;
+
+    std::thread([task, function, arg]() {
+        current_task = task;
+        try {
+            function(arg);
+        } catch (task_deleted &) {
+        }
+
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->deleted = true;
+        task->notified.notify_all();
+    }).detach();
+
+    return task;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) {
+        throw task_deleted();
+    }
+
+    // The task unwinds from ulTaskNotifyTake()
+    std::unique_lock<std::mutex> lock(task->lock);
+    task->delete_requested = true;
+    task->notified.notify_all();
+    task->notified.wait(lock, [task] { return task->deleted; });
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period) {
+    *previous_wake += period;
+    std::this_thread::sleep_until(start_time + std::chrono::milliseconds(*previous_wake));
+}
+
+TickType_t xTaskGetTickCount() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start_time)
+        .count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // Threads not started by xTaskCreate (such as the one running main) get a control
+    // block the first time they need one
+    if (current_task == NULL) {
+        current_task = new tskTaskControlBlock();
+    }
+    return current_task;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandleForCPU(BaseType_t core) { return NULL; }
+
+eTaskState eTaskGetState(TaskHandle_t task) {
+    std::lock_guard<std::mutex> guard(task->lock);
+    return task->deleted ? eDeleted : eBlocked;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return 0; }
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *tasks, UBaseType_t max_tasks,
+                                 uint32_t *total_run_time) {
+    *total_run_time = 0;
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (task == NULL) {
+        return pdFAIL;
+    }
+
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notify_value++;
+    task->notified.notify_all();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    tskTaskControlBlock *task = xTaskGetCurrentTaskHandle();
+
+    std::unique_lock<std::mutex> lock(task->lock);
+    bool woken = wait(lock, task->notified, ticks,
+                      [task] { return task->notify_value > 0 || task->delete_requested; });
+    if (task->delete_requested) {
+        throw task_deleted();
+    }
+    if (!woken) {
+        return 0;
+    }
+
+    uint32_t value = task->notify_value;
+    task->notify_value = clear ? 0 : value - 1;
+    return value;
+}
+
+///////////////////////////////// Queues ///////////////////////////////////////
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                 StaticQueue_t *queue_buffer) {
+    QueueDefinition *queue = new (queue_buffer) QueueDefinition();
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!wait(lock, queue->changed, ticks, [queue] { return queue->count < queue->length; })) {
+        return pdFAIL;
+    }
+
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!wait(lock, queue->changed, ticks, [queue] { return queue->count > 0; })) {
+        return pdFAIL;
+    }
+
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return queue->count;
+}
+
+///////////////////////////////// Semaphores ///////////////////////////////////
+
+// A semaphore is a queue of empty items. Taking it receives one, and giving it sends one.
+static SemaphoreHandle_t create_semaphore(StaticSemaphore_t *buffer, UBaseType_t max_count,
+                                          UBaseType_t initial_count) {
+    QueueDefinition *semaphore = new (buffer) QueueDefinition();
+    semaphore->length = max_count;
+    semaphore->count = initial_count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+    return create_semaphore(buffer, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buffer) {
+    SemaphoreHandle_t semaphore = create_semaphore(buffer, 1, 1);
+    semaphore->recursive = true;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    return create_semaphore(buffer, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count,
+                                                 UBaseType_t initial_count,
+                                                 StaticSemaphore_t *buffer) {
+    return create_semaphore(buffer, max_count, initial_count);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    if (!wait(lock, semaphore->changed, ticks, [semaphore] { return semaphore->count > 0; })) {
+        return pdFAIL;
+    }
+
+    semaphore->count--;
+    semaphore->holder = std::this_thread::get_id();
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count == semaphore->length) {
+        return pdFAIL;
+    }
+
+    semaphore->count++;
+    semaphore->holder = std::thread::id();
+    semaphore->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    {
+        std::lock_guard<std::mutex> guard(semaphore->lock);
+        if (semaphore->depth > 0 && semaphore->holder == std::this_thread::get_id()) {
+            semaphore->depth++;
+            return pdPASS;
+        }
+    }
+
+    if (xSemaphoreTake(semaphore, ticks) != pdPASS) {
+        return pdFAIL;
+    }
+
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    semaphore->depth = 1;
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    {
+        std::lock_guard<std::mutex> guard(semaphore->lock);
+        if (semaphore->depth == 0 || semaphore->holder != std::this_thread::get_id()) {
+            return pdFAIL;
+        }
+        if (--semaphore->depth > 0) {
+            return pdPASS;
+        }
+    }
+
+    return xSemaphoreGive(semaphore);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {}
@@ -0,0 +1,62 @@
+#ifndef MOCK_FREERTOS_H
+#define MOCK_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FreeRTOS for the host build. Tasks are threads, and queues, semaphores and task
+// notifications are built on mutexes and condition variables. Ticks are milliseconds.
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configMAX_PRIORITIES 25
+#define portNUM_PROCESSORS 2
+
+#define configUSE_TRACE_FACILITY 0
+#define configGENERATE_RUN_TIME_STATS 0
+
+struct tskTaskControlBlock;
+typedef struct tskTaskControlBlock *TaskHandle_t;
+
+struct QueueDefinition;
+typedef struct QueueDefinition *QueueHandle_t;
+
+// The mocks build their objects inside the static buffers, so these only need to be
+// big enough and suitably aligned
+typedef struct {
+    alignas(16) uint8_t storage[512];
+} StaticTask_t;
+
+typedef struct {
+    alignas(16) uint8_t storage[256];
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+
+// Critical sections are a spin lock per mux, as on the ESP32
+typedef struct {
+    volatile int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
+
+#endif /* MOCK_FREERTOS_H */
@@ -0,0 +1,40 @@
+#ifndef MOCK_FREERTOS_TASK_H
+#define MOCK_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    uint32_t ulRunTimeCounter;
+} TaskStatus_t;
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char *name,
+                                           uint32_t stack_depth, void *arg,
+                                           UBaseType_t priority, StackType_t *stack,
+                                           StaticTask_t *task_buffer, BaseType_t core);
+
+// A task can delete itself, or another task that is waiting in ulTaskNotifyTake(). Deleting
+// another task returns once its thread has finished.
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+// Tasks run on threads rather than cores, so no task is reported as running on a core
+TaskHandle_t xTaskGetCurrentTaskHandleForCPU(BaseType_t core);
+eTaskState eTaskGetState(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *tasks, UBaseType_t max_tasks,
+                                 uint32_t *total_run_time);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+
+#endif /* MOCK_FREERTOS_TASK_H */
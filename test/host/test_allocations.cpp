@@ -0,0 +1,55 @@
+// Nothing is allocated once setup is done, apart from clip memory
+
+#include "host_test.h"
+#include "yboard.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// Counts every allocation made with new, on any thread. Task creation is counted too, as
+// the FreeRTOS mocks start each task on a thread.
+static std::atomic<uint32_t> new_count(0);
+
+void *operator new(size_t size) {
+    new_count++;
+    void *ptr = malloc(size ? size : 1);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t size) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t size) noexcept { free(ptr); }
+
+int main() {
+    Yboard.setup();
+    const std::string notes = "T240 C D E";
+
+    uint32_t news = new_count;
+    uint32_t heap_caps = mock_heap_caps_allocations();
+
+    CHECK(Yboard.play_notes(notes));
+    Yboard.set_all_leds_color(10, 20, 30);
+    CHECK(Yboard.send_ir(0x12345678, 32));
+
+    // Recording runs on a task that was started by setup, so making clips doesn't
+    // create one. The clip's memory is the only allocation.
+    for (int i = 0; i < 3; i++) {
+        int clip = Yboard.start_clip_recording(20);
+        CHECK(clip >= 0);
+        delay(50);
+        Yboard.stop_recording();
+        CHECK(Yboard.play_clip(clip));
+        Yboard.delete_clip(clip);
+    }
+
+    CHECK(new_count == news);
+    CHECK(mock_heap_caps_allocations() == heap_caps + 3);
+
+    host_test::finish();
+}
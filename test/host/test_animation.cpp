@@ -0,0 +1,44 @@
+// LED animation handles
+
+#include "host_test.h"
+#include "yboard.h"
+
+static led_animation make_fade(uint32_t period_ms, bool loop) {
+    led_animation animation = {};
+    animation.effect = led_effect::fade;
+    animation.first_led = 1;
+    animation.last_led = 5;
+    animation.color = CRGB(255, 0, 0);
+    animation.color2 = CRGB(0, 0, 255);
+    animation.period_ms = period_ms;
+    animation.loop = loop;
+    return animation;
+}
+
+int main() {
+    Yboard.setup();
+
+    int first = Yboard.start_led_animation(make_fade(50, false));
+    CHECK(first >= 0);
+    CHECK(Yboard.is_led_animation_running(first));
+    delay(200);
+    CHECK(!Yboard.is_led_animation_running(first));
+
+    // The next animation gets the finished one's slot, but a new handle
+    int second = Yboard.start_led_animation(make_fade(1000, true));
+    CHECK(second >= 0 && second != first);
+    CHECK(!Yboard.is_led_animation_running(first));
+
+    // The old handle no longer names anything, so it can't stop the new animation
+    Yboard.stop_led_animation(first);
+    CHECK(Yboard.is_led_animation_running(second));
+    Yboard.stop_led_animation(second);
+    CHECK(!Yboard.is_led_animation_running(second));
+
+    // Handles that were never given out name nothing
+    CHECK(!Yboard.is_led_animation_running(-1));
+    CHECK(!Yboard.is_led_animation_running(0));
+    CHECK(!Yboard.is_led_animation_running(12345));
+
+    host_test::finish();
+}
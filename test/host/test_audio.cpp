@@ -0,0 +1,75 @@
+// Sound file playback through the resampler
+
+#include "host_test.h"
+#include "yboard.h"
+
+#include <math.h>
+
+static void put_le(std::vector<uint8_t> &data, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        data.push_back(value >> (8 * i));
+    }
+}
+
+// A WAV file holding a 440 Hz tone
+static std::vector<uint8_t> make_wav(uint32_t rate, uint16_t bits, uint32_t frames) {
+    uint32_t data_bytes = frames * bits / 8;
+    std::vector<uint8_t> wav;
+    wav.insert(wav.end(), {'R', 'I', 'F', 'F'});
+    put_le(wav, 36 + data_bytes, 4);
+    wav.insert(wav.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    put_le(wav, 16, 4);
+    put_le(wav, 1, 2); // PCM
+    put_le(wav, 1, 2); // Mono
+    put_le(wav, rate, 4);
+    put_le(wav, rate * bits / 8, 4);
+    put_le(wav, bits / 8, 2);
+    put_le(wav, bits, 2);
+    wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+    put_le(wav, data_bytes, 4);
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        float sample = sinf(2.0f * (float)M_PI * 440.0f * frame / rate);
+        if (bits == 8) {
+            wav.push_back(128 + lroundf(100.0f * sample));
+        } else {
+            put_le(wav, (uint16_t)lroundf(10000.0f * sample), 2);
+        }
+    }
+    return wav;
+}
+
+// Plays a file and returns the number of bytes it sent to the speaker
+static uint64_t play(const char *filename) {
+    I2SStream &speaker = YAudio::get_speaker_stream();
+    uint64_t before = speaker.mock_bytes_written();
+    CHECK(Yboard.play_sound_file(filename));
+    return speaker.mock_bytes_written() - before;
+}
+
+int main() {
+    // 4923 frames at 48 kHz end just after an output sample, so a position carried over
+    // from the last play changes how many samples the file makes
+    SD.mock_add_file("/8bit.wav", make_wav(44100, 8, 4410));
+    SD.mock_add_file("/48k.wav", make_wav(48000, 16, 4923));
+    Yboard.setup();
+
+    // 8-bit files are played, one speaker sample per frame at the speaker's rate
+    CHECK(play("8bit.wav") == 4410 * sizeof(int16_t));
+
+    // Each play of a file starts the resampler afresh, so it always gives the same output
+    uint64_t first = play("48k.wav");
+    CHECK(first > 0);
+    CHECK(play("48k.wav") == first);
+    CHECK(play("48k.wav") == first);
+
+    // The speaker going quiet between sounds isn't an underrun
+    uint32_t underruns = YProfile::get_counter(YProfile::audio_underruns);
+    delay(300);
+    play("8bit.wav");
+    delay(300);
+    CHECK(Yboard.play_notes("T240 C D E"));
+    CHECK(YProfile::get_counter(YProfile::audio_underruns) == underruns);
+
+    host_test::finish();
+}
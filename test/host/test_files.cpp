@@ -0,0 +1,75 @@
+// File index and handle cache
+
+#include "host_test.h"
+#include "yfiles.h"
+
+#include <SD.h>
+
+static std::string read_string(File &file, size_t length) {
+    std::string text(length, '\0');
+    text.resize(file.read((uint8_t *)&text[0], length));
+    return text;
+}
+
+static void test_readers_have_their_own_handles() {
+    File first = YFiles::open_read("/song.txt");
+    File second = YFiles::open_read("/song.txt");
+    CHECK(first && second);
+
+    // Opening the file again neither rewinds nor shares the first reader's handle
+    CHECK(read_string(first, 3) == "abc");
+    CHECK(read_string(second, 2) == "ab");
+    CHECK(read_string(first, 3) == "def");
+
+    YFiles::release(first);
+    CHECK(!first);
+    CHECK(read_string(second, 2) == "cd");
+    YFiles::release(second);
+}
+
+static void test_released_handles_are_reused() {
+    File file = YFiles::open_read("/song.txt");
+    read_string(file, 4);
+    YFiles::release(file);
+
+    // The released handle comes back rewound, without asking the card
+    uint32_t opens = SD.mock_open_count();
+    file = YFiles::open_read("/SONG.TXT");
+    CHECK(SD.mock_open_count() == opens);
+    CHECK(read_string(file, 3) == "abc");
+
+    // While it is out of the cache, another reader gets a different handle
+    File other = YFiles::open_read("/song.txt");
+    CHECK(read_string(other, 3) == "abc");
+    CHECK(read_string(file, 3) == "def");
+    YFiles::release(file);
+    YFiles::release(other);
+}
+
+static void test_directories_exist() {
+    // Directories are indexed along with the files, as the card reports them too
+    CHECK(YFiles::exists("/"));
+    CHECK(YFiles::exists("/sounds"));
+    CHECK(YFiles::exists("/Sounds/Effects"));
+    CHECK(!YFiles::exists("/music"));
+
+    // Only files have a size or can be opened
+    size_t size;
+    CHECK(!YFiles::get_size("/sounds", size));
+    CHECK(!YFiles::open_read("/sounds"));
+    CHECK(YFiles::get_size("/sounds/effects/beep.wav", size) && size == 4);
+}
+
+int main() {
+    const char *text = "abcdefghij";
+    SD.mock_add_file("/song.txt", std::vector<uint8_t>(text, text + 10));
+    SD.mock_add_file("/sounds/effects/beep.wav", std::vector<uint8_t>(text, text + 4));
+    CHECK(YFiles::setup(SD));
+    CHECK(YFiles::exists("/song.txt"));
+
+    test_readers_have_their_own_handles();
+    test_released_handles_are_reused();
+    test_directories_exist();
+
+    host_test::finish();
+}
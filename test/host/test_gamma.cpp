@@ -0,0 +1,32 @@
+// The LED gamma and brightness tables against the formulas they were made from
+
+#include "host_test.h"
+#include "ygamma.h"
+
+#include <math.h>
+
+int main() {
+    for (int i = 0; i < 256; i++) {
+        int expected = (int)roundf(255 * powf(i / 255.0f, 2.2f));
+        CHECK(YLeds::gamma_table[i] == expected);
+    }
+
+    // The brightness curve set_led_brightness computed with pow() before the table
+    for (int brightness = 0; brightness <= YLeds::max_brightness; brightness++) {
+        float normalized = (float)brightness / 220;
+        int expected = 220 * pow(normalized, 2.2f);
+        CHECK(YLeds::brightness_table[brightness] == expected);
+    }
+
+    // Both curves keep their ends, and never go down
+    CHECK(YLeds::gamma_table[255] == 255);
+    CHECK(YLeds::brightness_table[YLeds::max_brightness] == YLeds::max_brightness);
+    for (int i = 1; i < 256; i++) {
+        CHECK(YLeds::gamma_table[i] >= YLeds::gamma_table[i - 1]);
+    }
+    for (int i = 1; i <= YLeds::max_brightness; i++) {
+        CHECK(YLeds::brightness_table[i] >= YLeds::brightness_table[i - 1]);
+    }
+
+    host_test::finish();
+}
@@ -0,0 +1,37 @@
+// I2C bus clocks
+
+#include "host_test.h"
+#include "yboard.h"
+
+// The display runs at the upper bus's configured clock and leaves the bus at it
+static bool display_keeps_clock(uint32_t frequency) {
+    return Yboard.display.mock_transfer_clock() == frequency &&
+           Yboard.display.mock_bus_clock() == frequency;
+}
+
+int main() {
+    Yboard.setup();
+    CHECK(Yboard.get_i2c_stats(i2c_bus::upper).frequency == 400000);
+
+    CHECK(Yboard.set_i2c_frequency(i2c_bus::upper, 100000));
+    CHECK(Yboard.get_i2c_stats(i2c_bus::upper).frequency == 100000);
+
+    // Through the board, and straight through the driver
+    Yboard.update_display();
+    CHECK(display_keeps_clock(100000));
+    Yboard.display.ssd1306_command(SSD1306_DISPLAYON);
+    CHECK(display_keeps_clock(100000));
+    Yboard.display.display();
+    CHECK(display_keeps_clock(100000));
+
+    CHECK(Yboard.set_i2c_frequency(i2c_bus::upper, 400000));
+    Yboard.display.display();
+    CHECK(display_keeps_clock(400000));
+
+    // Out of range clocks are refused and change nothing
+    CHECK(!Yboard.set_i2c_frequency(i2c_bus::upper, 1000000));
+    Yboard.display.display();
+    CHECK(display_keeps_clock(400000));
+
+    host_test::finish();
+}
@@ -0,0 +1,115 @@
+// IR receive and transmit through the background tasks
+
+#include "host_test.h"
+#include "yboard.h"
+#include "yprofile.h"
+
+// Waits up to a second for the receive task to queue a frame
+static bool wait_for_frame(ir_frame &frame) { return Yboard.get_ir_frame(frame, 1000); }
+
+// Checks a frame's raw timings are the NEC bits of value, as the mock receiver makes them
+static bool raw_matches(const ir_frame &frame, uint64_t value, uint16_t bits) {
+    if (frame.results.rawbuf != frame.raw || frame.results.rawlen != 3 + bits * 2) {
+        return false;
+    }
+    for (int bit = 0; bit < bits; bit++) {
+        bool one = (value >> (bits - 1 - bit)) & 1;
+        if (frame.results.rawbuf[4 + bit * 2] != (one ? 1690 : 560)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_frames_keep_their_timings() {
+    // Both frames are decoded before either is read, so the second capture has
+    // overwritten the receiver's buffer by the time the first is looked at
+    Yboard.ir_recv.mock_receive(NEC, 0x00FF00FF, 32);
+    Yboard.ir_recv.mock_receive(NEC, 0xF0F0F0F0, 32);
+    delay(100);
+
+    ir_frame first, second;
+    CHECK(wait_for_frame(first));
+    CHECK(wait_for_frame(second));
+    CHECK(first.results.value == 0x00FF00FF);
+    CHECK(second.results.value == 0xF0F0F0F0);
+    CHECK(raw_matches(first, 0x00FF00FF, 32));
+    CHECK(raw_matches(second, 0xF0F0F0F0, 32));
+}
+
+static void test_recv_ir_keeps_its_timings() {
+    Yboard.ir_recv.mock_receive(NEC, 0x12345678, 32);
+    Yboard.ir_recv.mock_receive(NEC, 0x87654321, 32);
+    delay(100);
+
+    CHECK(Yboard.recv_ir());
+    decode_results first = Yboard.ir_results;
+    uint16_t first_timing = first.rawbuf[4];
+
+    // The second capture and reading its frame leave ir_results' timings alone
+    ir_frame second;
+    CHECK(wait_for_frame(second));
+    CHECK(second.results.value == 0x87654321);
+    CHECK(first.rawbuf[4] == first_timing);
+    CHECK(first_timing == 560);
+}
+
+static void test_overflow_counts_dropped_frames() {
+    // Only the frame queue can overflow here
+    Yboard.set_input_event_filter(input_all & ~input_ir);
+    uint32_t dropped = YProfile::get_counter(YProfile::dropped_events);
+
+    // Four more frames than the queue holds, so the four oldest are discarded
+    for (int i = 0; i < 20; i++) {
+        Yboard.ir_recv.mock_receive(NEC, 0xA0000000 + i, 32);
+    }
+    delay(300);
+    CHECK(YProfile::get_counter(YProfile::dropped_events) == dropped + 4);
+
+    ir_frame frame;
+    CHECK(wait_for_frame(frame));
+    CHECK(frame.results.value == 0xA0000004);
+    while (Yboard.get_ir_frame(frame, 0)) {
+    }
+    Yboard.set_input_event_filter(input_all);
+}
+
+static const uint64_t failing_value = 0xDEADBEEF;
+
+// Queues a send that fails, from the transmit task, once the first send is done
+static void queue_failing_send(bool success, void *arg) {
+    Yboard.send_ir_background(failing_value, 32);
+}
+
+static void test_send_ir_returns_its_own_result() {
+    Yboard.ir_send.mock_fail_value(failing_value);
+    Yboard.ir_send.mock_hold_value(failing_value);
+
+    // The failing send is queued after the blocking one, and must neither hold it up
+    // nor change its result. It is held until the blocking send has been checked.
+    CHECK(Yboard.send_ir_background(0x11111111, 32, 0, queue_failing_send));
+    CHECK(Yboard.send_ir(0x22222222, 32));
+    CHECK(Yboard.is_ir_sending());
+
+    Yboard.ir_send.mock_release();
+    while (Yboard.is_ir_sending()) {
+        delay(1);
+    }
+    CHECK(Yboard.ir_send.mock_last_value() == failing_value);
+
+    // And a blocking send that fails says so, whatever else is sent
+    CHECK(!Yboard.send_ir(failing_value, 32));
+    CHECK(Yboard.send_ir(0x33333333, 32));
+    CHECK(Yboard.ir_send.mock_last_value() == 0x33333333);
+}
+
+int main() {
+    Yboard.setup();
+
+    test_frames_keep_their_timings();
+    test_recv_ir_keeps_its_timings();
+    test_overflow_counts_dropped_frames();
+    test_send_ir_returns_its_own_result();
+
+    host_test::finish();
+}
@@ -0,0 +1,32 @@
+// Knob velocity
+
+#include "host_test.h"
+#include "yboard.h"
+
+// Turns the knob one count at a time, every interval_ms
+static void turn(int steps, int interval_ms) {
+    ESP32Encoder *encoder = ESP32Encoder::mock_attached;
+    for (int i = 0; i < abs(steps); i++) {
+        encoder->setCount(encoder->getCount() + (steps < 0 ? -1 : 1));
+        delay(interval_ms);
+    }
+}
+
+int main() {
+    Yboard.setup();
+    CHECK(ESP32Encoder::mock_attached != NULL);
+
+    turn(20, 10);
+    CHECK(Yboard.get_knob_velocity() > 0);
+
+    // Once the knob stops the speed settles at 0, not a few counts either side of it
+    delay(250);
+    CHECK(Yboard.get_knob_velocity() == 0);
+
+    turn(-20, 10);
+    CHECK(Yboard.get_knob_velocity() < 0);
+    delay(250);
+    CHECK(Yboard.get_knob_velocity() == 0);
+
+    host_test::finish();
+}
@@ -0,0 +1,36 @@
+// LED power budget limiting
+
+#include "host_test.h"
+#include "yboard.h"
+
+// 35 LEDs and the status LED, at about 1 mA each when dark
+static const uint32_t idle_ma = 36;
+
+int main() {
+    Yboard.setup();
+    Yboard.set_led_brightness(220);
+
+    // Unlimited
+    Yboard.set_led_power_budget(0);
+    Yboard.set_all_leds_color(255, 255, 255);
+    uint32_t full_ma = Yboard.get_led_current();
+    CHECK(full_ma > 800);
+
+    // Dimmed to fit
+    Yboard.set_led_power_budget(500);
+    CHECK(Yboard.get_led_current() <= 500);
+    CHECK(Yboard.get_led_current() > idle_ma);
+
+    // No room above the idle current, so the LEDs are turned off rather than left at
+    // full brightness
+    Yboard.set_led_power_budget(idle_ma);
+    CHECK(Yboard.get_led_current() == idle_ma);
+    Yboard.set_led_power_budget(1);
+    CHECK(Yboard.get_led_current() == idle_ma);
+
+    // Dark frames are within any budget
+    Yboard.set_all_leds_color(0, 0, 0);
+    CHECK(Yboard.get_led_current() == idle_ma);
+
+    host_test::finish();
+}
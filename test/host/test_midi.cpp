@@ -0,0 +1,126 @@
+// MIDI file reading
+
+#include "host_test.h"
+#include "ymidi.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+typedef std::vector<uint8_t> bytes;
+
+static size_t read_bytes(void *context, uint32_t offset, uint8_t *buffer, size_t len) {
+    const bytes *data = static_cast<const bytes *>(context);
+    if (offset >= data->size()) {
+        return 0;
+    }
+    len = std::min(len, data->size() - offset);
+    memcpy(buffer, data->data() + offset, len);
+    return len;
+}
+
+static void put_be(bytes &data, uint32_t value, int len) {
+    for (int i = len - 1; i >= 0; i--) {
+        data.push_back(value >> (8 * i));
+    }
+}
+
+// A file made of the given tracks' events, each ending with an end of track event
+static bytes make_file(uint16_t format, uint16_t division, const std::vector<bytes> &tracks) {
+    bytes file = {'M', 'T', 'h', 'd'};
+    put_be(file, 6, 4);
+    put_be(file, format, 2);
+    put_be(file, tracks.size(), 2);
+    put_be(file, division, 2);
+
+    for (const bytes &events : tracks) {
+        file.insert(file.end(), {'M', 'T', 'r', 'k'});
+        put_be(file, events.size() + 4, 4);
+        file.insert(file.end(), events.begin(), events.end());
+        file.insert(file.end(), {0x00, 0xFF, 0x2F, 0x00});
+    }
+    return file;
+}
+
+static std::vector<YAudio::midi_event_t> read_all(bytes &file) {
+    std::vector<YAudio::midi_event_t> events;
+    YAudio::MidiReader reader;
+    CHECK(reader.begin(read_bytes, &file));
+
+    YAudio::midi_event_t event;
+    while (reader.next_event(event)) {
+        events.push_back(event);
+    }
+    return events;
+}
+
+static void test_header() {
+    YAudio::MidiReader reader;
+    bytes track = {0x00, 0x90, 60, 100};
+
+    bytes file = make_file(0, 96, {track});
+    CHECK(reader.begin(read_bytes, &file));
+
+    // Format 2 files, files without a time division and other data aren't played
+    file = make_file(2, 96, {track});
+    CHECK(!reader.begin(read_bytes, &file));
+    file = make_file(1, 0, {track});
+    CHECK(!reader.begin(read_bytes, &file));
+    file = bytes(32, 0);
+    CHECK(!reader.begin(read_bytes, &file));
+}
+
+static void test_running_status() {
+    // The second and third notes repeat the note on status, and the third turns the first
+    // note off with a velocity of 0
+    bytes file = make_file(0, 96, {{0x00, 0x91, 60, 100, 0x60, 62, 90, 0x00, 60, 0}});
+    std::vector<YAudio::midi_event_t> events = read_all(file);
+
+    CHECK(events.size() == 3);
+    if (events.size() == 3) {
+        CHECK(events[0].note_on && events[0].note == 60 && events[0].channel == 1);
+        CHECK(events[1].note_on && events[1].note == 62 && events[1].velocity == 90);
+        CHECK(events[1].channel == 1);
+        CHECK(!events[2].note_on && events[2].note == 60);
+        CHECK(events[1].time_us == 500000 && events[2].time_us == 500000);
+    }
+}
+
+static void test_tempo_changes() {
+    // At the default 120 beats per minute, a quarter note (96 ticks) is half a second.
+    // Halving the tempo after the first note makes the next quarter note take a second.
+    bytes tempo_track = {0x60, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40};
+    bytes note_track = {0x60, 0x90, 60, 100, 0x60, 0x80, 60, 0};
+    bytes file = make_file(1, 96, {tempo_track, note_track});
+    std::vector<YAudio::midi_event_t> events = read_all(file);
+
+    CHECK(events.size() == 2);
+    if (events.size() == 2) {
+        CHECK(events[0].time_us == 500000);
+        CHECK(events[1].time_us == 1500000);
+    }
+}
+
+static void test_extra_tracks_are_left_out() {
+    // A tempo track and a track for each of 16 channels, one more than can be played
+    std::vector<bytes> tracks = {{0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20}};
+    for (int channel = 0; channel < 16; channel++) {
+        tracks.push_back({(uint8_t)channel, (uint8_t)(0x90 | channel), 60, 100});
+    }
+    bytes file = make_file(1, 96, tracks);
+    std::vector<YAudio::midi_event_t> events = read_all(file);
+
+    CHECK((int)events.size() == YAudio::MidiReader::max_tracks - 1);
+    for (size_t i = 0; i < events.size(); i++) {
+        CHECK(events[i].channel == i);
+    }
+}
+
+int main() {
+    test_header();
+    test_running_status();
+    test_tempo_changes();
+    test_extra_tracks_are_left_out();
+
+    host_test::finish();
+}
@@ -0,0 +1,47 @@
+// Task slots are free for the sketch once setup is done
+
+#include "host_test.h"
+#include "yboard.h"
+
+#include <atomic>
+
+// Library tasks that stay running after setup
+static const int permanent_tasks = 7;
+
+static std::atomic<int> started(0);
+
+static void waiting_task(void *params) {
+    started++;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+int main() {
+    Yboard.setup();
+
+    // The setup helpers have given their slots back, so every other slot can be used
+    TaskHandle_t handles[YTasks::max_tasks];
+    int free_slots = YTasks::max_tasks - permanent_tasks;
+    int created = 0;
+    while (created < free_slots &&
+           YTasks::create(waiting_task, "waiting_task", 2048, NULL, {1, 1}, &handles[created])) {
+        created++;
+    }
+    CHECK(created == free_slots);
+    CHECK(!YTasks::create(waiting_task, "waiting_task", 2048, NULL, {1, 1}));
+
+    while (started < created) {
+        delay(1);
+    }
+
+    // Stopped tasks free their slots too
+    for (int i = 0; i < created; i++) {
+        YTasks::stop(handles[i]);
+    }
+    for (int i = 0; i < free_slots; i++) {
+        CHECK(YTasks::create(waiting_task, "waiting_task", 2048, NULL, {1, 1}, &handles[i]));
+    }
+
+    host_test::finish();
+}